@@ -0,0 +1,245 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// A camera command as a plain record, so queueing it never allocates.
+struct CameraCommand {
+    enum class Type : uint8_t {
+        MOVE,               //arg1 = pan speed, arg2 = tilt speed, sign is the direction
+        STOP,
+        ZOOM_IN,            //arg1 = speed
+        ZOOM_OUT,           //arg1 = speed
+        ZOOM_STOP,
+        FOCUS_FAR,          //arg1 = speed
+        FOCUS_NEAR,         //arg1 = speed
+        FOCUS_STOP,
+        AUTO_FOCUS,
+        MANUAL_FOCUS,
+        FOCUS_AM,
+        SET_PRESET,         //arg1 = preset no.
+        CALL_PRESET,        //arg1 = preset no.
+        POWER_ON,
+        POWER_OFF,
+        MENU,
+        MENU_UP,
+        MENU_DOWN,
+        MENU_LEFT,
+        MENU_RIGHT,
+        MENU_ENTER,
+        MENU_BACK,
+        AUTO_FRAMING_START,
+        AUTO_FRAMING_STOP,
+        ABSOLUTE_PAN_TILT,  //arg1 = pan position, arg2 = tilt position, arg3 = speed
+        ZOOM_DIRECT,        //arg1 = zoom position
+        PAN_TILT_POS_INQ,   //inquiries, the reply updates the camera state
+        ZOOM_POS_INQ,
+        FOCUS_MODE_INQ,
+        POWER_INQ
+    };
+
+    // Commands of the same class share one "latest value wins" slot per camera
+    enum class Class : uint8_t {
+        NONE,           //every command is queued
+        PAN_TILT,
+        ZOOM,
+        FOCUS,
+        FOCUS_MODE,
+        CALL_PRESET,
+        SET_PRESET,
+        POWER,
+        NUM_CLASSES
+    };
+
+    // Queued commands are sent highest priority first, a stop never waits behind other work
+    enum class Priority : uint8_t {
+        STOP,
+        MOTION,
+        PRESET,
+        CONTROL,        //menu and power
+        NUM_PRIORITIES
+    };
+
+    Type    type;
+    int16_t arg1;
+    int16_t arg2;
+    int16_t arg3;
+
+    static constexpr CameraCommand make(Type t, int a1 = 0, int a2 = 0, int a3 = 0) {
+        return CameraCommand{t, static_cast<int16_t>(a1), static_cast<int16_t>(a2), static_cast<int16_t>(a3)};
+    }
+
+    constexpr bool operator==(const CameraCommand& o) const {
+        return type == o.type && arg1 == o.arg1 && arg2 == o.arg2 && arg3 == o.arg3;
+    }
+    constexpr bool operator!=(const CameraCommand& o) const { return !(*this == o); }
+
+    static constexpr Class classOf(Type t) {
+        return (t == Type::MOVE || t == Type::STOP || t == Type::ABSOLUTE_PAN_TILT)? Class::PAN_TILT :
+               (t == Type::ZOOM_IN || t == Type::ZOOM_OUT || t == Type::ZOOM_STOP || t == Type::ZOOM_DIRECT)? Class::ZOOM :
+               (t == Type::FOCUS_FAR || t == Type::FOCUS_NEAR || t == Type::FOCUS_STOP)? Class::FOCUS :
+               (t == Type::AUTO_FOCUS || t == Type::MANUAL_FOCUS)? Class::FOCUS_MODE :
+               (t == Type::CALL_PRESET)? Class::CALL_PRESET :
+               (t == Type::SET_PRESET)? Class::SET_PRESET :
+               (t == Type::POWER_ON || t == Type::POWER_OFF)? Class::POWER : Class::NONE;
+    }
+
+    static constexpr Priority priorityOf(Type t) {
+        return (t == Type::STOP || t == Type::ZOOM_STOP || t == Type::FOCUS_STOP)? Priority::STOP :
+               (t == Type::CALL_PRESET || t == Type::SET_PRESET)? Priority::PRESET :
+               (t == Type::POWER_ON || t == Type::POWER_OFF || t == Type::MENU || t == Type::MENU_UP ||
+                t == Type::MENU_DOWN || t == Type::MENU_LEFT || t == Type::MENU_RIGHT || t == Type::MENU_ENTER ||
+                t == Type::MENU_BACK)? Priority::CONTROL : Priority::MOTION;
+    }
+
+    // Pending work of this class is dropped when the command is queued, any new pan/tilt or zoom target cancels a preset recall
+    static constexpr Class cancelledBy(Type t) {
+        return (t == Type::STOP || t == Type::MOVE || t == Type::ABSOLUTE_PAN_TILT || t == Type::ZOOM_DIRECT)?
+            Class::CALL_PRESET : Class::NONE;
+    }
+
+    // For state-like classes, a command equal to the last one sent is not sent again. Absolute targets are
+    // always sent, the camera may have been moved since by something that did not go through the queue.
+    static constexpr bool isSkippedIfUnchanged(Type t) {
+        return (classOf(t) == Class::PAN_TILT || classOf(t) == Class::ZOOM || classOf(t) == Class::FOCUS ||
+                classOf(t) == Class::FOCUS_MODE) && t != Type::ABSOLUTE_PAN_TILT && t != Type::ZOOM_DIRECT;
+    }
+
+    // Commands that start a continuous movement, which lasts until the matching stop
+    static constexpr bool isMotion(Type t) {
+        return t == Type::MOVE || t == Type::ZOOM_IN || t == Type::ZOOM_OUT || t == Type::FOCUS_FAR || t == Type::FOCUS_NEAR;
+    }
+
+    // Sending these twice has the same effect as sending them once, so they can be retransmitted
+    static constexpr bool isIdempotent(Type t) {
+        return !(t == Type::FOCUS_AM || t == Type::MENU || t == Type::MENU_UP || t == Type::MENU_DOWN ||
+                 t == Type::MENU_LEFT || t == Type::MENU_RIGHT || t == Type::MENU_ENTER || t == Type::MENU_BACK);
+    }
+
+    static constexpr bool isInquiry(Type t) {
+        return t == Type::PAN_TILT_POS_INQ || t == Type::ZOOM_POS_INQ || t == Type::FOCUS_MODE_INQ || t == Type::POWER_INQ;
+    }
+
+    Class cmdClass() const { return classOf(type); }
+};
+
+// Fixed-capacity FIFO of command records.
+template <size_t N>
+class CameraCommandRing {
+    static_assert((N & (N-1)) == 0, "capacity must be a power of 2");
+    public:
+        bool empty() const { return head == tail; }
+        bool full() const { return tail - head == N; }
+        size_t size() const { return tail - head; }
+        bool push(const CameraCommand& cmd) {
+            if (full()) return false;
+            buf[tail++ & (N-1)] = cmd;
+            return true;
+        }
+        CameraCommand pop() { return buf[head++ & (N-1)]; }
+        void clear() { head = tail = 0; }
+
+    private:
+        CameraCommand buf[N];
+        size_t head = 0;
+        size_t tail = 0;
+};
+
+// Command queue of one camera, one ring per priority. A command of a coalescing
+// class occupies a single ring entry while pending; newer commands of that class
+// only overwrite its value, or move it to a higher priority ring. The entry left
+// behind in the lower ring is skipped when reached.
+template <size_t N>
+class CameraCommandQueue {
+    public:
+        bool push(const CameraCommand& cmd) {
+            CameraCommand::Class cancelled = CameraCommand::cancelledBy(cmd.type);
+            if (cancelled != CameraCommand::Class::NONE) slot[static_cast<size_t>(cancelled)].isPending = false;
+
+            size_t level = static_cast<size_t>(CameraCommand::priorityOf(cmd.type));
+            CameraCommand::Class c = cmd.cmdClass();
+            if (c == CameraCommand::Class::NONE) return ring[level].push(cmd);
+            Slot& s = slot[static_cast<size_t>(c)];
+            if (s.isPending && s.level <= level) {
+                s.value = cmd;
+                return true;
+            }
+            if (!ring[level].push(cmd)) return false;
+            s.value = cmd;
+            s.isPending = true;
+            s.level = level;
+            return true;
+        }
+
+        // Next command by priority, queue order within a priority. Returns false when the queue is empty.
+        bool pop(CameraCommand& cmd) {
+            for (size_t level = 0; level < NUM_LEVELS; level++) {
+                while (!ring[level].empty()) {
+                    cmd = ring[level].pop();
+                    CameraCommand::Class c = cmd.cmdClass();
+                    if (c == CameraCommand::Class::NONE) return true;
+                    Slot& s = slot[static_cast<size_t>(c)];
+                    if (!s.isPending || s.level != level) continue; //moved up or cancelled
+                    s.isPending = false;
+                    cmd = s.value;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // The pending command of one class, ahead of the queue order. Its ring entry is skipped later.
+        bool popClass(CameraCommand::Class c, CameraCommand& cmd) {
+            Slot& s = slot[static_cast<size_t>(c)];
+            if (!s.isPending) return false;
+            s.isPending = false;
+            cmd = s.value;
+            return true;
+        }
+
+        bool isPending(CameraCommand::Class c) const { return slot[static_cast<size_t>(c)].isPending; }
+
+        // A state command the camera already has need not be sent
+        bool isUnchanged(const CameraCommand& cmd) const {
+            CameraCommand::Class c = cmd.cmdClass();
+            const Slot& s = slot[static_cast<size_t>(c)];
+            return CameraCommand::isSkippedIfUnchanged(cmd.type) && s.hasLastSent && s.lastSent == cmd;
+        }
+
+        // Record what the camera was told, or forget it when the camera may have lost it
+        void markSent(const CameraCommand& cmd) {
+            Slot& s = slot[static_cast<size_t>(cmd.cmdClass())];
+            s.lastSent = cmd;
+            s.hasLastSent = true;
+        }
+        void invalidate(CameraCommand::Class c) { slot[static_cast<size_t>(c)].hasLastSent = false; }
+        void cancel(CameraCommand::Class c) { slot[static_cast<size_t>(c)].isPending = false; }
+        void invalidateAll() {
+            for (Slot& s : slot) s.hasLastSent = false;
+        }
+
+        bool empty() const {
+            for (const CameraCommandRing<N>& r : ring) {
+                if (!r.empty()) return false;
+            }
+            return true;
+        }
+        void clear() {
+            for (CameraCommandRing<N>& r : ring) r.clear();
+            for (Slot& s : slot) s.isPending = false;
+        }
+
+    private:
+        static constexpr size_t NUM_LEVELS = static_cast<size_t>(CameraCommand::Priority::NUM_PRIORITIES);
+        struct Slot {
+            CameraCommand value;
+            CameraCommand lastSent;
+            bool isPending = false;
+            bool hasLastSent = false;
+            size_t level = 0;   //ring holding the pending entry
+        };
+        CameraCommandRing<N> ring[NUM_LEVELS];
+        Slot slot[static_cast<size_t>(CameraCommand::Class::NUM_CLASSES)];
+};
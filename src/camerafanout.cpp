@@ -0,0 +1,54 @@
+// vim:ts=4:sw=4:et:cin
+
+#include "camerafanout.h"
+#include <QTimer>
+
+CameraFanOut* CameraFanOut::send(CameraIo* cameras, const CameraCommand& cmd,
+        int timeoutMs, QObject* parent)
+{
+    return new CameraFanOut(cameras, cmd, timeoutMs, parent);
+}
+
+CameraFanOut::CameraFanOut(CameraIo* cameras, const CameraCommand& command,
+        int timeoutMs, QObject* parent)
+    : QObject(parent), cmd(command), isPending(cameras->size(), true), nPending(cameras->size())
+{
+    results.reserve(cameras->size());
+    connections.reserve(cameras->size());
+    for (size_t i = 0; i < cameras->size(); i++) {
+        results.push_back(Result{cameras->camera(i)->cameraId(), CommandResult::TIMEOUT});
+        connections.push_back(connect(cameras->camera(i), &CameraConnect::commandFinished, this,
+                [this, i](const CameraCommand& c, CommandResult r) {onCommandFinished(i, c, r);}));
+    }
+
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &CameraFanOut::finish);
+    timer->start(timeoutMs);
+
+    //Connected first, so a camera finishing right away is not missed
+    cameras->addCommandToAll(cmd);
+
+    //Results are delivered asynchronously, even without cameras
+    if (cameras->size() == 0) QTimer::singleShot(0, this, &CameraFanOut::finish);
+}
+
+void CameraFanOut::onCommandFinished(size_t idx, const CameraCommand& c, CommandResult result)
+{
+    if (!isPending[idx] || c != cmd) return;
+    isPending[idx] = false;
+    results[idx].result = result;
+    //Deferred, so finished() is not emitted from within the camera signal
+    if (--nPending == 0) QTimer::singleShot(0, this, &CameraFanOut::finish);
+}
+
+void CameraFanOut::finish()
+{
+    if (isFinished) return;
+    isFinished = true;
+    for (const QMetaObject::Connection& c : connections) disconnect(c);
+    connections.clear();
+    timer->stop();
+    emit finished(results);
+    deleteLater();
+}
@@ -0,0 +1,49 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <vector>
+#include <QObject>
+#include "cameracommand.h"
+#include "visca.h"
+#include "cameraio.h"
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+// Sends one command to several cameras at once. Each camera pipeline sends it
+// independently, cameras sharing a serial line get one broadcast frame, and
+// finished() reports every camera's result once all have replied or the timeout
+// has passed. The object deletes itself afterwards.
+class CameraFanOut : public QObject {
+    Q_OBJECT
+    public:
+        struct Result {
+            int           cameraId;
+            CommandResult result;
+        };
+
+        //Long enough for a command queued behind one in flight, plus a retransmission
+        static constexpr int DEFAULT_TIMEOUT_MS = CameraConnect::UDP_TIMEOUT_MS * (CameraConnect::MAX_RETRANSMIT + 2);
+
+        // To every camera of the I/O thread, results arrive in the caller's thread
+        static CameraFanOut* send(CameraIo* cameras, const CameraCommand& cmd,
+                int timeoutMs = DEFAULT_TIMEOUT_MS, QObject* parent = nullptr);
+
+    signals:
+        void finished(const std::vector<CameraFanOut::Result>& results);
+
+    private:
+        CameraFanOut(CameraIo* cameras, const CameraCommand& cmd, int timeoutMs, QObject* parent);
+        void onCommandFinished(size_t idx, const CameraCommand& cmd, CommandResult result);
+        void finish();
+
+        const CameraCommand cmd;
+        std::vector<Result> results;
+        std::vector<bool> isPending;
+        size_t nPending;
+        bool isFinished = false;
+        std::vector<QMetaObject::Connection> connections;
+        QTimer* timer;
+};
@@ -0,0 +1,174 @@
+// vim:ts=4:sw=4:et:cin
+
+#include "cameraio.h"
+#include <algorithm>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+#include "visca.h"
+#include "viscatransport.h"
+#include "viscaserialline.h"
+
+static QThread::Priority threadPriority(CameraIoSettings::Priority priority)
+{
+    switch (priority) {
+        case CameraIoSettings::Priority::HIGH:          return QThread::HighestPriority;
+        case CameraIoSettings::Priority::TIME_CRITICAL: return QThread::TimeCriticalPriority;
+        default:                                        return QThread::InheritPriority;
+    }
+}
+
+CameraIo::CameraIo(const std::vector<CameraSettings>& cameraSettings, const CameraIoSettings& ioSettings,
+        QObject* parent)
+    : QObject(parent), watchdogMs(ioSettings.MOTION_WATCHDOG_MS)
+{
+    qRegisterMetaType<CameraCommand>();
+    qRegisterMetaType<CommandResult>();
+    qRegisterMetaType<CameraState>();
+    qRegisterMetaType<PowerState>();
+
+    //Created here and moved as a whole, the cameras defer their first network activity to the I/O thread
+    worker = new QObject;
+    transport = new ViscaTransport(worker);
+    cameras.reserve(cameraSettings.size());
+    for (const CameraSettings& camera : cameraSettings) {
+        ViscaSerialLine* line = nullptr;
+        if (camera.isSerial()) {
+            //Cameras naming the same port share its line, the settings allow one protocol per port
+            bool isVisca = !camera.isPelco();
+            for (ViscaSerialLine* l : lines) {
+                if (l->portName() == camera.CAMERA_HOST) line = l;
+            }
+            if (!line) {
+                line = new ViscaSerialLine(camera.CAMERA_HOST, camera.SERIAL_BAUD, isVisca, worker);
+                lines.push_back(line);
+            }
+        }
+        lineOf.push_back(line);
+        cameras.push_back(new CameraConnect(camera, transport, line, worker));
+    }
+
+    //A few ticks per window, so a camera is stopped at most a quarter window late
+    if (watchdogMs > 0) {
+        QTimer* watchdog = new QTimer(worker);
+        watchdog->setInterval(std::max(watchdogMs / 4, 1));
+        connect(watchdog, &QTimer::timeout, worker, [this]() {checkWatchdogs();});
+        QMetaObject::invokeMethod(watchdog, "start", Qt::QueuedConnection);
+    }
+
+    ioThread = new QThread(this);
+    ioThread->setObjectName("camera-io");
+    worker->moveToThread(ioThread);
+    //Deleted in the I/O thread, where their timers and socket notifier live
+    connect(ioThread, &QThread::finished, worker, &QObject::deleteLater);
+    ioThread->start(threadPriority(ioSettings.THREAD_PRIORITY));
+}
+
+CameraIo::~CameraIo()
+{
+    ioThread->quit();
+    ioThread->wait();
+}
+
+void CameraIo::addCommand(unsigned camIdx, const CameraCommand& cmd)
+{
+    post(Request{Request::Op::ADD_COMMAND, static_cast<uint16_t>(camIdx), cmd});
+}
+
+void CameraIo::addCommandToAll(const CameraCommand& cmd)
+{
+    post(Request{Request::Op::ADD_COMMAND_TO_ALL, 0, cmd});
+}
+
+void CameraIo::clearCommandQueue(unsigned camIdx)
+{
+    post(Request{Request::Op::CLEAR_QUEUE, static_cast<uint16_t>(camIdx), {}});
+}
+
+void CameraIo::refreshState(unsigned camIdx)
+{
+    post(Request{Request::Op::REFRESH_STATE, static_cast<uint16_t>(camIdx), {}});
+}
+
+void CameraIo::refreshMotion(unsigned camIdx)
+{
+    post(Request{Request::Op::REFRESH_MOTION, static_cast<uint16_t>(camIdx), {}});
+}
+
+void CameraIo::post(const Request& req)
+{
+    if (!ring.push(req)) {
+        qWarning("Camera I/O queue full, request %d to camera index %u dropped.", int(req.op), unsigned(req.camIdx));
+        return;
+    }
+    //One wake-up for all requests posted until drain() runs. The fence pairs with the one in drain(),
+    //so either drain() sees this request or the flag is already cleared and a new wake-up is posted.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!isWakePending.exchange(true)) {
+        QMetaObject::invokeMethod(worker, [this]() {drain();}, Qt::QueuedConnection);
+    }
+}
+
+void CameraIo::drain()
+{
+    isWakePending.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    Request req;
+    while (ring.pop(req)) {
+        CameraConnect* camera = (req.camIdx < cameras.size())? cameras[req.camIdx] : nullptr;
+        if (!camera && req.op != Request::Op::ADD_COMMAND_TO_ALL) {
+            qWarning("Camera I/O request %d to camera index %u out of range.", int(req.op), unsigned(req.camIdx));
+            continue;
+        }
+        switch (req.op) {
+            case Request::Op::ADD_COMMAND:
+                camera->addCommand(req.cmd);
+                break;
+            case Request::Op::ADD_COMMAND_TO_ALL:
+                commandAll(req.cmd);
+                break;
+            case Request::Op::CLEAR_QUEUE:
+                camera->clearCommandQueue();
+                break;
+            case Request::Op::REFRESH_STATE:
+                camera->refreshState();
+                break;
+            case Request::Op::REFRESH_MOTION:
+                camera->refreshMotionIntent();
+                break;
+        }
+    }
+}
+
+void CameraIo::commandAll(const CameraCommand& cmd)
+{
+    std::vector<bool> isBroadcast(cameras.size(), false);
+    for (ViscaSerialLine* line : lines) {
+        if (!line->isOpen() || !line->isViscaLine()) continue;  //sent per camera
+        CameraConnect* first = nullptr;
+        size_t n = 0;
+        for (size_t i = 0; i < cameras.size(); i++) {
+            if (lineOf[i] != line) continue;
+            if (!first) first = cameras[i];
+            n++;
+        }
+        if (n < 2) continue;
+        bool isSent = first->sendBroadcast(cmd);
+        for (size_t i = 0; i < cameras.size(); i++) {
+            if (lineOf[i] != line) continue;
+            cameras[i]->onBroadcast(cmd, isSent);
+            isBroadcast[i] = true;
+        }
+    }
+    for (size_t i = 0; i < cameras.size(); i++) {
+        if (!isBroadcast[i]) cameras[i]->addCommand(cmd);
+    }
+}
+
+void CameraIo::checkWatchdogs()
+{
+    //Requests already posted may hold the fresh intent
+    drain();
+    for (CameraConnect* camera : cameras) camera->checkMotionWatchdog(watchdogMs);
+}
@@ -0,0 +1,67 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <QObject>
+#include "cameracommand.h"
+#include "cvcsetting.h"
+#include "spscring.h"
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+class CameraConnect;
+class ViscaTransport;
+class ViscaSerialLine;
+
+// Runs the camera pipelines and their shared transport in a thread of their own,
+// so encoding, sending, reply parsing and timeouts are not held up by the GUI.
+// The GUI thread hands requests over through a lock-free ring; the camera signals
+// reach GUI objects as queued connections.
+class CameraIo : public QObject {
+    Q_OBJECT
+    public:
+        CameraIo(const std::vector<CameraSettings>& cameras, const CameraIoSettings& ioSettings,
+                QObject* parent = nullptr);
+        virtual ~CameraIo();
+
+        static constexpr size_t RING_SIZE = 1024;
+
+        // Called from the GUI thread only, the ring has a single producer
+        void addCommand(unsigned camIdx, const CameraCommand& cmd);
+        // Power or stop for every camera, a serial line with several cameras gets one broadcast frame
+        void addCommandToAll(const CameraCommand& cmd);
+        void clearCommandQueue(unsigned camIdx);
+        void refreshState(unsigned camIdx); //stateRefreshed() of the camera follows
+        void refreshMotion(unsigned camIdx); //the operator still wants the camera to move
+
+        size_t size() const { return cameras.size(); }
+        // For connecting to the camera signals and for its settings, calls belong to the I/O thread
+        const CameraConnect* camera(unsigned camIdx) const { return cameras[camIdx]; }
+
+    private:
+        struct Request {
+            enum class Op : uint8_t { ADD_COMMAND, ADD_COMMAND_TO_ALL, CLEAR_QUEUE, REFRESH_STATE, REFRESH_MOTION };
+            Op            op;
+            uint16_t      camIdx;
+            CameraCommand cmd;
+        };
+        void post(const Request& req);
+        void drain(); //runs in the I/O thread
+        void checkWatchdogs(); //runs in the I/O thread
+        void commandAll(const CameraCommand& cmd); //runs in the I/O thread
+
+        QThread* ioThread;
+        QObject* worker;    //lives in the I/O thread, parent of the transport and the cameras
+        ViscaTransport* transport;
+        std::vector<CameraConnect*> cameras;
+        std::vector<ViscaSerialLine*> lines;
+        std::vector<ViscaSerialLine*> lineOf;   //per camera, nullptr for IP cameras
+        const int watchdogMs;
+
+        SpscRing<Request, RING_SIZE> ring;
+        std::atomic<bool> isWakePending{false};
+};
@@ -1,4 +1,4 @@
-QT       += core gui gamepad widgets network websockets
+QT       += core gui gamepad widgets network websockets serialport
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -31,16 +31,31 @@ SOURCES += \
     cvcsetting.cpp \
     streamdeckconnect.cpp \
     streamdeckkey.cpp \
-    matrixconnect.cpp
+    matrixconnect.cpp \
+    presetstore.cpp \
+    camerafanout.cpp \
+    viscatransport.cpp \
+    viscaserialline.cpp \
+    cameraio.cpp
 
 HEADERS += \
     cvcpelcod.h \
     visca.h \
+    cameracommand.h \
+    viscaencoder.h \
     obsconnect.h \
     cvcsetting.h \
     streamdeckconnect.h \
     streamdeckkey.h \
-    matrixconnect.h
+    matrixconnect.h \
+    presetstore.h \
+    stickcurve.h \
+    camerafanout.h \
+    viscatransport.h \
+    viscaserialline.h \
+    pelcoencoder.h \
+    spscring.h \
+    cameraio.h
 
 FORMS += \
     cvcpelcod.ui
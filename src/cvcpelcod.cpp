@@ -5,6 +5,7 @@
 #else
 #include <unistd.h>
 #endif
+#include <algorithm>
 #include <QtGamepad/QGamepad>
 #include <QTimer>
 #include <QDir>
@@ -16,6 +17,9 @@
 #include "obsconnect.h"
 #include "streamdeckconnect.h"
 #include "matrixconnect.h"
+#include "presetstore.h"
+#include "camerafanout.h"
+#include "cameraio.h"
 
 CVCPelcoD::CVCPelcoD(QWidget *parent)
     : QMainWindow(parent)
@@ -25,6 +29,8 @@ CVCPelcoD::CVCPelcoD(QWidget *parent)
     try {
         settings.parseJSON(QDir::homePath() + "/.cvc-stream-control.conf");
     } catch (const std::exception &e) {
+        //Cameras read before the error are not driven, there is no camera I/O
+        settings.CAMERAS.clear();
         ui->statusbar->showMessage(e.what());
         return;
     }
@@ -46,12 +52,6 @@ CVCPelcoD::CVCPelcoD(QWidget *parent)
         gamepad = new QGamepad(*gamepads.begin(), this);
         ui->statusbar->showMessage("Gamepad connected.");
 
-        connect(gamepad,&QGamepad::axisLeftXChanged, this, &CVCPelcoD::ptzCam);
-        connect(gamepad,&QGamepad::axisLeftYChanged, this, &CVCPelcoD::ptzCam);
-        connect(gamepad,&QGamepad::buttonL2Changed, this, &CVCPelcoD::zoomCam);
-        connect(gamepad,&QGamepad::buttonR2Changed, this, &CVCPelcoD::zoomCam);
-        connect(gamepad,&QGamepad::buttonYChanged, this, &CVCPelcoD::focusCam);
-        connect(gamepad,&QGamepad::buttonAChanged, this, &CVCPelcoD::focusCam);
         connect(gamepad,&QGamepad::buttonL1Changed, this, &CVCPelcoD::selectPrevCam);
         connect(gamepad,&QGamepad::buttonR1Changed, this, &CVCPelcoD::selectNextCam);
         connect(gamepad,&QGamepad::axisRightXChanged, this, &CVCPelcoD::selectPreset);
@@ -66,15 +66,35 @@ CVCPelcoD::CVCPelcoD(QWidget *parent)
         connect(gamepad,&QGamepad::buttonGuideChanged, this, &CVCPelcoD::switchOBSStudioMode);
     }
 
-    //Camera
-    for (const CameraSettings& camera : settings.CAMERAS) {
-        CameraConnect* connection = new CameraConnect(camera, this);
-        cameraConnect.push_back(connection);
-        connect(connection,&QUdpSocket::readyRead, this, &CVCPelcoD::execNextCommand);
+    //Camera, the pipelines run in the camera I/O thread
+    cameraIo = new CameraIo(settings.CAMERAS, settings.CAMERA_IO, this);
+    for (unsigned idx = 0; idx < cameraIo->size(); idx++) {
+        connect(cameraIo->camera(idx), &CameraConnect::stateRefreshed, this,
+                [this, idx](const CameraState& state) {storeHostPreset(idx, state);});
+        connect(cameraIo->camera(idx), &CameraConnect::powerStateChanged, this,
+                [this, idx](PowerState state) {
+                    //Commands wait in the camera queue meanwhile, there is no need to press again
+                    bool wasBooting = camState[idx].isBooting;
+                    camState[idx].isBooting = (state == PowerState::BOOTING);
+                    if (camState[idx].isBooting) {
+                        ui->statusbar->showMessage(QString("Camera %1 is starting up...").arg(settings.CAMERAS[idx].CAMERA_ID));
+                    } else if (wasBooting) {
+                        ui->statusbar->showMessage(QString("Camera %1 is ready.").arg(settings.CAMERAS[idx].CAMERA_ID));
+                    }
+                });
+        if (settings.CAMERAS[idx].HOST_PRESET && !presetStore) {
+            presetStore = new PresetStore(QDir::homePath() + "/.cvc-stream-control.presets");
+        }
     }
-    cameraConnect.shrink_to_fit();
-    udp_timeout = new QTimer (this);
-    connect(udp_timeout,&QTimer::timeout, this, &CVCPelcoD::execNextCommand);
+    camState.resize(cameraIo->size());
+    pendingHostPreset.assign(cameraIo->size(), -1);
+
+    //Sticks, triggers and focus buttons are sampled at a fixed rate, so a burst of axis events
+    //becomes at most one command per tick. Each tick also refreshes the motion intent of moving cameras.
+    controlTimer = new QTimer(this);
+    controlTimer->setTimerType(Qt::PreciseTimer);
+    connect(controlTimer, &QTimer::timeout, this, &CVCPelcoD::controlLoop);
+    controlTimer->start(std::max(1u, 1000 / settings.GAMEPAD.CONTROL_RATE_HZ));
 
     //OBS
     obsScene = {{
@@ -158,6 +178,7 @@ CVCPelcoD::~CVCPelcoD()
     //[TODO] this will call seg Fault
     //if(streamDeckConnect) delete streamDeckConnect;
     if(matrixConnect) delete matrixConnect;
+    if(presetStore) delete presetStore;
     delete ui;
 }
 
@@ -176,29 +197,29 @@ void CVCPelcoD::closeEvent(QCloseEvent *event)
                                                                 tr("Turn off all cameras and reset matrix?\n"),
                                                                 QMessageBox::Cancel | QMessageBox::No | QMessageBox::Yes,
                                                                 QMessageBox::Yes);
-    if (resBtn == QMessageBox::Yes) {
+    if (resBtn == QMessageBox::Yes && !cameraIo) {
+        //The settings could not be read, there is nothing to turn off
+        event->accept();
+    } else if (resBtn == QMessageBox::Yes) {
         is_shutting_down = true;
         setEnabled(false);
         ui->statusbar->showMessage("Shutting down...");
 
         // 1. clear pending commands
-        std::queue<std::function<bool()>> empty;
-        cmdQueue.swap(empty);
-        udp_timeout->stop();
-        is_sock_idle = true;
-
-        // 2. wait for 0.5 seconds.
-        QTimer::singleShot(UDP_TIMEOUT_MS, this, [this]() {
-            // 3. Turn off cameras directly and reset matrix.
-            for (CameraConnect* conn : cameraConnect) {
-                conn->viscaOff();
-            }
-            if (matrixConnect) {
-                matrixConnect->resetMatrix();
-            }
+        for (unsigned i = 0; i < cameraIo->size(); i++) {
+            cameraIo->clearCommandQueue(i);
+        }
 
-            // 4. Wait a bit more for packets to be sent before closing.
-            QTimer::singleShot(UDP_TIMEOUT_MS, this, [this]() {
+        // 2. Turn off all cameras at once and reset matrix.
+        CameraFanOut* fanOut = CameraFanOut::send(cameraIo, CameraCommand::make(CameraCommand::Type::POWER_OFF),
+                CameraFanOut::DEFAULT_TIMEOUT_MS, this);
+        if (matrixConnect) {
+            matrixConnect->resetMatrix();
+        }
+
+        // 3. Close when every camera has replied or timed out, giving the matrix request some time.
+        connect(fanOut, &CameraFanOut::finished, this, [this]() {
+            QTimer::singleShot(matrixConnect? CameraConnect::UDP_TIMEOUT_MS : 0, this, [this]() {
                 final_close = true;
                 close();
             });
@@ -212,14 +233,25 @@ void CVCPelcoD::closeEvent(QCloseEvent *event)
     }
 }
 
-void CVCPelcoD::startup()
+static QString fanOutStatus(const QString& action, const std::vector<CameraFanOut::Result>& results)
 {
-    for (size_t i = 0; i < cameraConnect.size(); ++i) {
-        addCommandToQueue([this, i]() -> bool {
-            cameraConnect[i]->viscaOn();
-            return true;
-        });
+    QString failed;
+    for (const CameraFanOut::Result& r : results) {
+        if (r.result == CommandResult::DONE) continue;
+        failed += QString(" %1(%2)").arg(r.cameraId).arg(r.result == CommandResult::TIMEOUT? "no reply" : "error");
     }
+    if (failed.isEmpty()) return action + ": all cameras";
+    return action + " failed:" + failed;
+}
+
+void CVCPelcoD::startup()
+{
+    if (!cameraIo) return; //the settings could not be read
+    CameraFanOut* fanOut = CameraFanOut::send(cameraIo, CameraCommand::make(CameraCommand::Type::POWER_ON),
+            CameraFanOut::DEFAULT_TIMEOUT_MS, this);
+    connect(fanOut, &CameraFanOut::finished, this, [this](const std::vector<CameraFanOut::Result>& results) {
+        ui->statusbar->showMessage(fanOutStatus("Cam On", results));
+    });
 
     if (matrixConnect) matrixConnect->resetMatrix();
 }
@@ -228,6 +260,7 @@ void CVCPelcoD::selectPrevCam(bool en)
 {
     if (en) {
         if (!settings.CAMERAS.empty() && camIndex > 0) {
+            releaseCam();
             ui->camNo->setNum(settings.CAMERAS[--camIndex].CAMERA_ID);
             if(streamDeckConnect) streamDeckConnect->setCamIndex(camIndex);
         }
@@ -238,6 +271,7 @@ void CVCPelcoD::selectNextCam(bool en)
 {
     if (en) {
         if (!settings.CAMERAS.empty() && camIndex < settings.CAMERAS.size()-1) {
+            releaseCam();
             ui->camNo->setNum(settings.CAMERAS[++camIndex].CAMERA_ID);
             if(streamDeckConnect) streamDeckConnect->setCamIndex(camIndex);
         }
@@ -247,6 +281,7 @@ void CVCPelcoD::selectNextCam(bool en)
 void CVCPelcoD::selectCam(int camIndex_)
 {
     if (camIndex_ >= 0 && camIndex_ < settings.CAMERAS.size()) {
+        if (camIndex_ != camIndex) releaseCam();
         ui->camNo->setNum(settings.CAMERAS[camIndex = camIndex_].CAMERA_ID);
         if(streamDeckConnect) streamDeckConnect->setCamIndex(camIndex);
     }
@@ -352,491 +387,304 @@ void CVCPelcoD::selectPreset()
     }
 }
 
-void CVCPelcoD::execNextCommand()
+void CVCPelcoD::addCommand(const CameraCommand& cmd, const QString& status)
 {
-    udp_timeout->stop();
-    if (!cmdQueue.empty()) {
-        bool isCmdSent = cmdQueue.front()();
-        cmdQueue.pop();
-        if (isCmdSent) {
-            udp_timeout->start (CVCPelcoD::UDP_TIMEOUT_MS);
-        } else {
-            execNextCommand();
-        }
+    if (settings.CAMERAS.empty()) return;
+    cameraIo->addCommand(camIndex, cmd);
+    if (!status.isEmpty()) ui->statusbar->showMessage(status);
+}
+
+void CVCPelcoD::zoomCam()
+{
+    if (settings.CAMERAS.empty()) return;
+    CamControlState& state = camState[camIndex];
+    double zoom = gamepad->buttonR2() - gamepad->buttonL2();
+    uint8_t speed = settings.CAMERAS[camIndex].ZOOM_CURVE.lookup(zoom);
+    int zoomValue = (speed == StickCurve::STOP)? 0 : (zoom > 0)? 1 : -1;
+    int newZoomSpeed = (zoomValue == 0)? 0 : speed;
+
+    if (newZoomSpeed == state.prevZoomSpeed && zoomValue == state.prevZoomValue) return;
+    if (zoomValue > 0) {
+        addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_IN, newZoomSpeed), QString("Zoom In Speed: ") + QString::number(newZoomSpeed));
+    } else if (zoomValue < 0) {
+        addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_OUT, newZoomSpeed), QString("Zoom Out Speed: ") + QString::number(newZoomSpeed));
     } else {
-        is_sock_idle = true;
+        addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_STOP), QString("Stop Zoom"));
     }
+    state.prevZoomValue = zoomValue;
+    state.prevZoomSpeed = newZoomSpeed;
 }
 
-void CVCPelcoD::addCommandToQueue(const std::function<bool()>& f)
+void CVCPelcoD::controlLoop()
 {
-    cmdQueue.push(f);
-    if (is_sock_idle) {
-        is_sock_idle = false;
-        execNextCommand();
+    if (gamepad) {
+        ptzCam();
+        zoomCam();
+        focusCam();
     }
-    return;
+    //Only live input keeps the driven camera clear of the motion watchdog, a lost gamepad or key release stops it
+    if (settings.CAMERAS.empty()) return;
+    const CamControlState& state = camState[camIndex];
+    bool isStickActive = gamepad && gamepad->isConnected() &&
+            (state.prevX || state.prevY || state.prevZoomValue || state.prevFocusValue);
+    if (isStickActive || state.isDeckMoving) cameraIo->refreshMotion(camIndex);
 }
 
-void CVCPelcoD::zoomCam()
+void CVCPelcoD::setDeckMoving(bool isMoving)
+{
+    if (!settings.CAMERAS.empty()) camState[camIndex].isDeckMoving = isMoving;
+}
+
+void CVCPelcoD::releaseCam()
 {
+    //The watchdog stops what is left moving, the input now drives the next camera
     if (settings.CAMERAS.empty()) return;
-    if (is_zoom_in_queue) return;
-    auto zoomFn = [this] () -> bool {
-        is_zoom_in_queue = false;
-        unsigned MAX_ZOOM_SPEED = settings.CAMERAS[camIndex].MAX_ZOOM_SPEED;
-        unsigned MIN_ZOOM_SPEED = settings.CAMERAS[camIndex].MIN_ZOOM_SPEED;
-        unsigned zoomSpeedRange = MAX_ZOOM_SPEED - MIN_ZOOM_SPEED + 1;
-        double zoomIn  = gamepad->buttonR2();
-        double zoomOut = gamepad->buttonL2();
-        double zoom = zoomIn - zoomOut;
-        int zoomValue = ((zoom > 0)? 1 : (zoom < 0)? -1 : 0);
-
-        double zoomSpeed = zoom;
-        if (zoomSpeed < 0) zoomSpeed = -zoomSpeed;
-        int newZoomSpeed = MIN_ZOOM_SPEED + static_cast<int>(zoomSpeed * (zoomSpeedRange-1));
-        if (newZoomSpeed < MIN_ZOOM_SPEED) newZoomSpeed = MIN_ZOOM_SPEED;
-        if (newZoomSpeed > MAX_ZOOM_SPEED) newZoomSpeed = MAX_ZOOM_SPEED;
-
-        if (camIndex != prevCam || newZoomSpeed != prevZoomSpeed || zoomValue != prevZoomValue) {
-            //if (isManualFocus[camIndex]) {
-                //cameraConnect[camIndex]->viscaAutoFocus();
-                //isManualFocus[camIndex] = false;
-            //}
-
-            if (zoomValue > 0) {
-                cameraConnect[camIndex]->viscaIn (newZoomSpeed);
-                ui->statusbar->showMessage(QString("Zoom In Speed: ") + QString::number(newZoomSpeed));
-            } else if (zoomValue < 0) {
-                cameraConnect[camIndex]->viscaOut (newZoomSpeed);
-                ui->statusbar->showMessage(QString("Zoom Out Speed: ") + QString::number(newZoomSpeed));
-            } else {
-                cameraConnect[camIndex]->viscaZoomStop ();
-                ui->statusbar->showMessage(QString("Stop Zoom"));
-            }
-            
-            prevZoomValue = zoomValue;
-            prevZoomSpeed = newZoomSpeed;
-            prevCam = camIndex;
-            return true;
-        } else {
-            return false;
-        }
-        //ui->statusbar->showMessage(QString("Zoom In = ") + QString::number(zoomIn) + " Zoom Out = " + QString::number(zoomOut));
-    };
-    is_zoom_in_queue = true;
-    addCommandToQueue(zoomFn);
+    CamControlState& state = camState[camIndex];
+    state.prevX = state.prevY = 0;
+    state.prevZoomValue = state.prevZoomSpeed = 0;
+    state.prevFocusValue = 0;
+    state.isDeckMoving = false;
 }
 
 void CVCPelcoD::focusCam()
 {
     if (settings.CAMERAS.empty()) return;
-    if (!is_manual_focus_in_queue) {
-        is_manual_focus_in_queue = true;
-        addCommandToQueue ([this] () -> bool {
-            is_manual_focus_in_queue = false;
-            cameraConnect[camIndex]->viscaManualFocus();
-            isManualFocus[camIndex] = true;
-            return true;
-        });
-    }
-
-    if (!is_focus_in_queue) {
-        is_focus_in_queue = true;
-        addCommandToQueue ([this] () -> bool {
-            is_focus_in_queue = false;
-            bool focusFar  = gamepad->buttonY();
-            bool focusNear = gamepad->buttonA();
-            if (focusFar == focusNear) focusFar = focusNear = false;
-            int focusValue = (focusFar? 1 : focusNear? -1 : 0);
-
-            if (camIndex != prevCam || focusValue != prevFocusValue) {
-                if (focusFar) {
-                    cameraConnect[camIndex]->viscaFar (settings.CAMERAS[camIndex].MIN_FOCUS_SPEED);
-                } else if (focusNear) {
-                    cameraConnect[camIndex]->viscaNear (settings.CAMERAS[camIndex].MIN_FOCUS_SPEED);
-                } else {
-                    cameraConnect[camIndex]->viscaFocusStop ();
-                }
-                
-                prevFocusValue = focusValue;
-                prevCam = camIndex;
-                return true;
-            } else {
-                return false;
-            }
-        });
+    CamControlState& state = camState[camIndex];
+    bool focusFar  = gamepad->buttonY();
+    bool focusNear = gamepad->buttonA();
+    if (focusFar == focusNear) focusFar = focusNear = false;
+    int focusValue = (focusFar? 1 : focusNear? -1 : 0);
+
+    if (focusValue == state.prevFocusValue) return;
+    unsigned speed = settings.CAMERAS[camIndex].MIN_FOCUS_SPEED;
+    //Manual focus is skipped by the camera queue if the camera is already in manual focus
+    if (focusFar) {
+        addCommand(CameraCommand::make(CameraCommand::Type::MANUAL_FOCUS));
+        addCommand(CameraCommand::make(CameraCommand::Type::FOCUS_FAR, speed));
+    } else if (focusNear) {
+        addCommand(CameraCommand::make(CameraCommand::Type::MANUAL_FOCUS));
+        addCommand(CameraCommand::make(CameraCommand::Type::FOCUS_NEAR, speed));
+    } else {
+        addCommand(CameraCommand::make(CameraCommand::Type::FOCUS_STOP));
     }
+    state.prevFocusValue = focusValue;
 }
 
 void CVCPelcoD::ptzCam()
 {
     if (settings.CAMERAS.empty()) return;
-    if (!is_ptz_in_queue) {
-        is_ptz_in_queue = true;
-        addCommandToQueue ([this] () -> bool {
-            is_ptz_in_queue = false;
-            unsigned MAX_PAN_SPEED = settings.CAMERAS[camIndex].MAX_PAN_SPEED;
-            unsigned MIN_PAN_SPEED = settings.CAMERAS[camIndex].MIN_PAN_SPEED;
-            unsigned MAX_TILT_SPEED = settings.CAMERAS[camIndex].MAX_TILT_SPEED;
-            unsigned MIN_TILT_SPEED = settings.CAMERAS[camIndex].MIN_TILT_SPEED;
-            double moveX = gamepad->axisLeftX();
-            double moveY = gamepad->axisLeftY();
-            int newMoveX = (MAX_PAN_SPEED - MIN_PAN_SPEED + 1) * moveX;
-            int newMoveY = (MAX_TILT_SPEED - MIN_TILT_SPEED + 1) * moveY;
-            if (newMoveX > 0) {
-                newMoveX += MIN_PAN_SPEED - 1;
-                if (newMoveX < MIN_PAN_SPEED) newMoveX = MIN_PAN_SPEED;
-            }
-            if (newMoveY > 0) {
-                newMoveY += MIN_TILT_SPEED - 1;
-                if (newMoveY < MIN_TILT_SPEED) newMoveY = MIN_TILT_SPEED;
-            }
-            if (newMoveX < 0) {
-                newMoveX -= MIN_PAN_SPEED - 1;
-                if (newMoveX > -MIN_PAN_SPEED) newMoveX = -MIN_PAN_SPEED;
-            }
-            if (newMoveY < 0) {
-                newMoveY -= MIN_TILT_SPEED - 1;
-                if (newMoveY > -MIN_TILT_SPEED) newMoveY = -MIN_TILT_SPEED;
-            }
-
-            if (newMoveX == 0 && newMoveY == 0) {
-                if (isCamMoving[camIndex]) {
-                    cameraConnect[camIndex]->viscaStop();
-                    ui->statusbar->showMessage("Move STOP");
-                    isCamMoving[camIndex] = false;
-                    prevCam = camIndex;
-                    prevX = newMoveX;
-                    prevY = newMoveY;
-                    return true;
-                } else {
-                    return false;
-                }
-            } else {
-                if (camIndex != prevCam || newMoveX != prevX || newMoveY != prevY) {
-                    if (!is_auto_focus_in_queue) {
-                        is_auto_focus_in_queue = true;
-                        addCommandToQueue ([this] () -> bool {
-                            is_auto_focus_in_queue = false;
-                            if (isManualFocus[camIndex]) {
-                                cameraConnect[camIndex]->viscaAutoFocus();
-                                isManualFocus[camIndex] = false;
-                                return true;
-                            } else {
-                                return false;
-                            }
-                        });
-                    }
-                    cameraConnect[camIndex]->viscaMove(newMoveX, newMoveY);
-                    ui->statusbar->showMessage(QString("X Speed = ") + QString::number(newMoveX) + " Y Speed = " + QString::number(newMoveY));
-                    isCamMoving[camIndex] = true;
-                    prevCam = camIndex;
-                    prevX = newMoveX;
-                    prevY = newMoveY;
-                    return true;
-                } else {
-                    return false;
-                }
-            }
-            //ui->statusbar->showMessage(QString("MoveX = ") + QString::number(moveX) + " MoveY = " + QString::number(moveY));
-        });
+    CamControlState& state = camState[camIndex];
+    const CameraSettings& camera = settings.CAMERAS[camIndex];
+    double moveX = gamepad->axisLeftX();
+    double moveY = gamepad->axisLeftY();
+    uint8_t panSpeed = camera.PAN_CURVE.lookup(moveX);
+    uint8_t tiltSpeed = camera.TILT_CURVE.lookup(moveY);
+    int newMoveX = (panSpeed == StickCurve::STOP)? 0 : (moveX > 0)? panSpeed : -panSpeed;
+    int newMoveY = (tiltSpeed == StickCurve::STOP)? 0 : (moveY > 0)? tiltSpeed : -tiltSpeed;
+
+    if (newMoveX == state.prevX && newMoveY == state.prevY) return;
+    if (newMoveX == 0 && newMoveY == 0) {
+        addCommand(CameraCommand::make(CameraCommand::Type::STOP), "Move STOP");
+    } else {
+        addCommand(CameraCommand::make(CameraCommand::Type::MOVE, newMoveX, newMoveY),
+                QString("X Speed = ") + QString::number(newMoveX) + " Y Speed = " + QString::number(newMoveY));
+        //Skipped by the camera queue if the camera is already in auto focus
+        addCommand(CameraCommand::make(CameraCommand::Type::AUTO_FOCUS));
     }
+    state.prevX = newMoveX;
+    state.prevY = newMoveY;
 }
 
 void CVCPelcoD::moveUp()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaUp(7);
-        ui->statusbar->showMessage("Up");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::MOVE, 0, -7), "Up");
 }
 
 void CVCPelcoD::moveDown()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaDown(7);
-        ui->statusbar->showMessage("Down");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::MOVE, 0, 7), "Down");
 }
 
 void CVCPelcoD::moveLeft()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaLeft(7);
-        ui->statusbar->showMessage("Left");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::MOVE, -7, 0), "Left");
 }
 
 void CVCPelcoD::moveRight()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaRight(7);
-        ui->statusbar->showMessage("Right");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::MOVE, 7, 0), "Right");
 }
 
 void CVCPelcoD::zoomOut()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaOut(0);
-        ui->statusbar->showMessage("Out");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_OUT, 0), "Out");
 }
 
 void CVCPelcoD::zoomIn()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaIn(0);
-        ui->statusbar->showMessage("In");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_IN, 0), "In");
 }
 
 void CVCPelcoD::ptzStop()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaStop();
-        return true;
-    });
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaZoomStop();
-        ui->statusbar->showMessage("Stop");
-        return true;
-    });
+    setDeckMoving(false);
+    addCommand(CameraCommand::make(CameraCommand::Type::STOP));
+    addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_STOP), "Stop");
 }
 
 void CVCPelcoD::focusFar()
 {
     if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaManualFocus();
-        return true;
-    });
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaFar (settings.CAMERAS[camIndex].MIN_FOCUS_SPEED);
-        ui->statusbar->showMessage("Far");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::MANUAL_FOCUS));
+    addCommand(CameraCommand::make(CameraCommand::Type::FOCUS_FAR, settings.CAMERAS[camIndex].MIN_FOCUS_SPEED), "Far");
 }
 
 void CVCPelcoD::focusNear()
 {
     if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaManualFocus();
-        return true;
-    });
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaNear (settings.CAMERAS[camIndex].MIN_FOCUS_SPEED);
-        ui->statusbar->showMessage("Near");
-        return true;
-    });
+    setDeckMoving(true);
+    addCommand(CameraCommand::make(CameraCommand::Type::MANUAL_FOCUS));
+    addCommand(CameraCommand::make(CameraCommand::Type::FOCUS_NEAR, settings.CAMERAS[camIndex].MIN_FOCUS_SPEED), "Near");
 }
 
 void CVCPelcoD::focusStop()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaFocusStop();
-        ui->statusbar->showMessage("Stop Focus");
-        return true;
-    });
+    setDeckMoving(false);
+    addCommand(CameraCommand::make(CameraCommand::Type::FOCUS_STOP), "Stop Focus");
 }
 
 void CVCPelcoD::focusAuto()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaAutoFocus();
-        ui->statusbar->showMessage("Auto Focus");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::AUTO_FOCUS), "Auto Focus");
 }
 
 void CVCPelcoD::callPreset(bool en)
 {
-    if (settings.CAMERAS.empty()) return;
     if (en) {
-        if (!is_call_preset_in_queue) {
-            is_call_preset_in_queue = true;
-            addCommandToQueue ([this] () -> bool {
-                is_call_preset_in_queue = false;
-                int presetNo = ui->presetNo->text().toInt();
-                cameraConnect[camIndex]->viscaGo(presetNo);
-                ui->statusbar->showMessage("CALL");
-                return true;
-            });
-        }
+        callPresetByNo(ui->presetNo->text().toInt());
     }
 }
 
 void CVCPelcoD::setPreset(bool en)
 {
-    if (settings.CAMERAS.empty()) return;
     if (en) {
-        if (!is_set_preset_in_queue) {
-            is_set_preset_in_queue = true;
-            addCommandToQueue ([this] () -> bool {
-                is_set_preset_in_queue = false;
-                int presetNo = ui->presetNo->text().toInt();
-                cameraConnect[camIndex]->viscaSet(presetNo);
-                ui->statusbar->showMessage("PRESET");
-                return true;
-            });
-        }
+        setPresetByNo(ui->presetNo->text().toInt());
     }
 }
 
 void CVCPelcoD::callPresetByNo(unsigned presetNo)
 {
     if (settings.CAMERAS.empty()) return;
-    if (settings.CAMERAS[camIndex].CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
+    const CameraSettings& camera = settings.CAMERAS[camIndex];
+    if (camera.HOST_PRESET) {
+        PresetStore::Position pos;
+        if (!presetStore || !presetStore->find(camera.CAMERA_ID, presetNo, pos)) {
+            ui->statusbar->showMessage("Preset " + QString::number(presetNo) + " is not set");
+            return;
+        }
+        //An absolute move replaces any moving command, no stop needed
+        addCommand(CameraCommand::make(CameraCommand::Type::ABSOLUTE_PAN_TILT, pos.pan, pos.tilt, camera.PRESET_SPEED));
+        addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_DIRECT, pos.zoom), "CALL " + QString::number(presetNo));
+        return;
+    }
+    if (camera.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
         //Strict protocol requires to stop moving before calling preset, otherwise the call command will be ignored.
-        addCommandToQueue ([this] () -> bool {
-            if (isCamMoving[camIndex]) {
-                cameraConnect[camIndex]->viscaStop();
-                return true;
-            }
-        });
+        //The stop is skipped by the camera queue if the camera is not moving.
+        addCommand(CameraCommand::make(CameraCommand::Type::STOP));
     }
-    addCommandToQueue ([this, presetNo] () -> bool {
-        cameraConnect[camIndex]->viscaGo(presetNo);
-        ui->statusbar->showMessage("CALL " + QString::number(presetNo));
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::CALL_PRESET, presetNo), "CALL " + QString::number(presetNo));
 }
 
 void CVCPelcoD::setPresetByNo(unsigned presetNo)
 {
     if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this, presetNo] () -> bool {
-        cameraConnect[camIndex]->viscaSet(presetNo);
-        ui->statusbar->showMessage("PRESET " + QString::number(presetNo));
-        return true;
-    });
+    if (settings.CAMERAS[camIndex].HOST_PRESET) {
+        //Stored once the camera has reported its current position
+        pendingHostPreset[camIndex] = presetNo;
+        cameraIo->refreshState(camIndex);
+        ui->statusbar->showMessage("PRESET " + QString::number(presetNo) + "...");
+        return;
+    }
+    addCommand(CameraCommand::make(CameraCommand::Type::SET_PRESET, presetNo), "PRESET " + QString::number(presetNo));
+}
+
+void CVCPelcoD::storeHostPreset(unsigned camIdx, const CameraState& state)
+{
+    if (pendingHostPreset[camIdx] < 0) return;
+    unsigned presetNo = pendingHostPreset[camIdx];
+    pendingHostPreset[camIdx] = -1;
+
+    if (!state.hasPanTilt || !state.hasZoom) {
+        ui->statusbar->showMessage("PRESET " + QString::number(presetNo) + " failed: camera position unknown");
+        return;
+    }
+    if (!presetStore || !presetStore->store(settings.CAMERAS[camIdx].CAMERA_ID, presetNo, {state.pan, state.tilt, state.zoom})) {
+        ui->statusbar->showMessage("PRESET " + QString::number(presetNo) + " failed: preset file not available");
+        return;
+    }
+    ui->statusbar->showMessage("PRESET " + QString::number(presetNo));
 }
 
 void CVCPelcoD::menuPressed()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaMenu();
-        ui->statusbar->showMessage("Menu");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::MENU), "Menu");
 }
 
 void CVCPelcoD::menuUp()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaMenuUp();
-        ui->statusbar->showMessage("Menu Up");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::MENU_UP), "Menu Up");
 }
 
 void CVCPelcoD::menuDown()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaMenuDown();
-        ui->statusbar->showMessage("Menu Down");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::MENU_DOWN), "Menu Down");
 }
 
 void CVCPelcoD::menuLeft()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaMenuLeft();
-        ui->statusbar->showMessage("Menu Left");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::MENU_LEFT), "Menu Left");
 }
 
 void CVCPelcoD::menuRight()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaMenuRight();
-        ui->statusbar->showMessage("Menu Right");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::MENU_RIGHT), "Menu Right");
 }
 
 void CVCPelcoD::menuEnter()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaMenuEnter();
-        ui->statusbar->showMessage("Menu Enter");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::MENU_ENTER), "Menu Enter");
 }
 
 void CVCPelcoD::menuBack()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaMenuBack();
-        ui->statusbar->showMessage("Menu Back");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::MENU_BACK), "Menu Back");
 }
 
 void CVCPelcoD::camOn()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaOn();
-        ui->statusbar->showMessage("Cam On");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::POWER_ON), "Cam On");
 }
 
 void CVCPelcoD::camOff()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaOff();
-        ui->statusbar->showMessage("Cam Off");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::POWER_OFF), "Cam Off");
 }
 
 void CVCPelcoD::autoFramingOn()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaAutoFramingStart();
-        ui->statusbar->showMessage("Auto Framing On");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::AUTO_FRAMING_START), "Auto Framing On");
 }
 
 void CVCPelcoD::autoFramingOff()
 {
-    if (settings.CAMERAS.empty()) return;
-    addCommandToQueue ([this] () -> bool {
-        cameraConnect[camIndex]->viscaAutoFramingStop();
-        ui->statusbar->showMessage("Auto Framing Off");
-        return true;
-    });
+    addCommand(CameraCommand::make(CameraCommand::Type::AUTO_FRAMING_STOP), "Auto Framing Off");
 }
 
 void CVCPelcoD::selectPrevOBSScene(bool en)
@@ -847,7 +695,7 @@ void CVCPelcoD::selectPrevOBSScene(bool en)
     if (en) {
         if (!timerPrevOBSScene) {
             auto selectPrev = [this] () {
-                uint_fast8_t prevScene = obsConnect->getPrevSceneId(curScene+1);
+                uint16_t prevScene = obsConnect->getPrevSceneId(curScene+1);
                 if (prevScene == 0) return;
                 if (curScene < obsScene.size()) obsScene[curScene]->setChecked(false);
                 curScene = prevScene-1;
@@ -875,7 +723,7 @@ void CVCPelcoD::selectNextOBSScene(bool en)
     if (en) {
         if (!timerNextOBSScene) {
             auto selectNext = [this] () {
-                uint_fast8_t nextScene = obsConnect->getNextSceneId(curScene+1);
+                uint16_t nextScene = obsConnect->getNextSceneId(curScene+1);
                 if (nextScene == 0) return;
                 if (curScene < obsScene.size()) obsScene[curScene]->setChecked(false);
                 curScene = nextScene-1;
@@ -915,7 +763,7 @@ void CVCPelcoD::selectOBSScene2(bool en)
     }
 }
 
-void CVCPelcoD::selectOBSScene(uint_fast8_t sceneId, uint_fast8_t)
+void CVCPelcoD::selectOBSScene(uint16_t sceneId, uint_fast8_t)
 {
     if (sceneId == 0) return;
     if (curScene < obsScene.size()) obsScene[curScene]->setChecked(false);
@@ -8,9 +8,8 @@
 #include <string>
 #include <array>
 #include <vector>
-#include <queue>
-#include <functional>
 #include "cvcsetting.h"
+#include "cameracommand.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class CVCPelcoD; }
@@ -25,6 +24,9 @@ class OBSConnect;
 class CameraConnect;
 class StreamDeckConnect;
 class MatrixConnect;
+class PresetStore;
+class CameraIo;
+struct CameraState;
 
 class CVCPelcoD : public QMainWindow
 {
@@ -50,10 +52,11 @@ private slots:
     void selectNextOBSScene(bool en);
     void selectOBSScene1(bool en);
     void selectOBSScene2(bool en);
-    void selectOBSScene(uint_fast8_t sceneId, uint_fast8_t);
+    void selectOBSScene(uint16_t sceneId, uint_fast8_t);
     void switchOBSScene(bool en);
     void switchOBSStudioMode(bool en);
 
+    void controlLoop();
     void ptzCam();
     void zoomCam();
     void focusCam();
@@ -84,15 +87,12 @@ private slots:
     void autoFramingOn();
     void autoFramingOff();
 
-    void execNextCommand();
-
     void onMatrixConnectionFailed();
 
 private:
-    static constexpr int UDP_TIMEOUT_MS = 500;
-
     Ui::CVCPelcoD *ui;
     QGamepad *gamepad = nullptr;
+    QTimer *controlTimer = nullptr;
     OBSConnect *obsConnect = nullptr;
     StreamDeckConnect *streamDeckConnect = nullptr;
     MatrixConnect *matrixConnect = nullptr;
@@ -101,30 +101,30 @@ private:
     std::array<QPushButton*,11> obsScene;
     unsigned curScene = 0;
 
-    std::map<int,bool> isCamMoving;// = {{2,false}, {3,false}, {4,false}};
-    std::map<int,bool> isManualFocus;// = {{2,false}, {3,false}, {4,false}};
     int camIndex = -1;
 
-    int prevZoomValue = 0;
-    int prevFocusValue = 0;
-    int prevX = 0;
-    int prevY = 0;
-    int prevZoomSpeed = 0;
-    int prevCam = 0;
-
-    // Socket related
-    std::vector<CameraConnect*> cameraConnect;
-    QTimer* udp_timeout;
-    std::queue<std::function<bool()>> cmdQueue;
-    bool is_sock_idle = true;
-    bool is_zoom_in_queue = false;
-    bool is_focus_in_queue = false;
-    bool is_ptz_in_queue = false;
-    bool is_manual_focus_in_queue = false;
-    bool is_auto_focus_in_queue = false;
-    bool is_call_preset_in_queue = false;
-    bool is_set_preset_in_queue = false;
-    void addCommandToQueue(const std::function<bool()>&);
+    // Last state requested from each camera by the gamepad
+    struct CamControlState {
+        int prevX = 0;
+        int prevY = 0;
+        int prevZoomValue = 0;
+        int prevZoomSpeed = 0;
+        int prevFocusValue = 0;
+        bool isDeckMoving = false;  //held Stream Deck move, zoom or focus key
+        bool isBooting = false;
+    };
+    std::vector<CamControlState> camState;
+
+    // Socket related, each camera has its own command pipeline on a shared socket, run by the camera I/O thread
+    CameraIo *cameraIo = nullptr;
+    void addCommand(const CameraCommand& cmd, const QString& status = QString()); //to the selected camera
+    void setDeckMoving(bool isMoving);
+    void releaseCam();  //before another camera is selected
+
+    // Host side presets
+    PresetStore *presetStore = nullptr;
+    std::vector<long> pendingHostPreset;    //preset no. stored on the next state refresh, -1 for none
+    void storeHostPreset(unsigned camIdx, const CameraState& state);
 
     // Shutdown related
     bool is_shutting_down = false;
@@ -61,7 +61,7 @@ void CVCSettings::parseJSON(const QString& filename) {
         QJsonObject cameraObject = value.toObject();
 
         // Check for required keys in each camera object
-        QStringList requiredKeys = { "CAMERA_ID", "CAMERA_HOST", "CAMERA_PORT", 
+        QStringList requiredKeys = { "CAMERA_ID", "CAMERA_HOST",
                                      "CAMERA_PROTOCAL", "MIN_ZOOM_SPEED", "MAX_ZOOM_SPEED", 
                                      "MIN_PAN_SPEED", "MAX_PAN_SPEED", "MIN_TILT_SPEED", 
                                      "MAX_TILT_SPEED", "MIN_FOCUS_SPEED", "MAX_FOCUS_SPEED", 
@@ -76,17 +76,58 @@ void CVCSettings::parseJSON(const QString& filename) {
         CameraSettings camera;
         camera.CAMERA_ID = cameraObject["CAMERA_ID"].toInt();
         camera.CAMERA_HOST = cameraObject["CAMERA_HOST"].toString();
-        camera.CAMERA_PORT = cameraObject["CAMERA_PORT"].toInt();
 
         QString protocolString = cameraObject["CAMERA_PROTOCAL"].toString();
         if (protocolString == "VISCA_STRICT") {
             camera.CAMERA_PROTOCAL = CameraSettings::Protocal::VISCA_STRICT;
         } else if (protocolString == "VISCA_LOOSE") {
             camera.CAMERA_PROTOCAL = CameraSettings::Protocal::VISCA_LOOSE;
+        } else if (protocolString == "VISCA_SERIAL") {
+            camera.CAMERA_PROTOCAL = CameraSettings::Protocal::VISCA_SERIAL;
+        } else if (protocolString == "PELCO_D") {
+            camera.CAMERA_PROTOCAL = CameraSettings::Protocal::PELCO_D;
+        } else if (protocolString == "PELCO_P") {
+            camera.CAMERA_PROTOCAL = CameraSettings::Protocal::PELCO_P;
         } else {
             throw std::runtime_error(QString("Unknown camera protocol: %1").arg(protocolString).toStdString());
         }
 
+        // Cameras on one serial line are told apart by their address
+        if (camera.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_SERIAL) {
+            camera.VISCA_ADDRESS = cameraObject["VISCA_ADDRESS"].toInt(1);
+            if (camera.VISCA_ADDRESS < 1 || camera.VISCA_ADDRESS > 7) {
+                throw std::runtime_error("'VISCA_ADDRESS' must be between 1 and 7.");
+            }
+        } else if (camera.isPelco()) {
+            int address = cameraObject["PELCO_ADDRESS"].toInt(1);
+            int minAddress = (camera.CAMERA_PROTOCAL == CameraSettings::Protocal::PELCO_D)? 1 : 0;
+            if (address < minAddress || address > 255) {
+                throw std::runtime_error(QString("'PELCO_ADDRESS' must be between %1 and 255.").arg(minAddress).toStdString());
+            }
+            camera.PELCO_ADDRESS = address;
+        }
+
+        if (camera.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_SERIAL ||
+                (camera.isPelco() && !cameraObject.contains("CAMERA_PORT"))) {
+            int baud = cameraObject["SERIAL_BAUD"].toInt(camera.SERIAL_BAUD);
+            if (baud != 2400 && baud != 4800 && baud != 9600 && baud != 19200 && baud != 38400 && baud != 115200) {
+                throw std::runtime_error("'SERIAL_BAUD' must be 2400, 4800, 9600, 19200, 38400 or 115200.");
+            }
+            camera.SERIAL_BAUD = baud;
+        } else {
+            if (!cameraObject.contains("CAMERA_PORT")) {
+                throw std::runtime_error("Missing 'CAMERA_PORT' key in camera settings.");
+            }
+            camera.CAMERA_PORT = cameraObject["CAMERA_PORT"].toInt();
+            // IP cameras and serial gateways are only reached over UDP
+            QString transportString = cameraObject["CAMERA_TRANSPORT"].toString("UDP");
+            if (transportString == "TCP") {
+                throw std::runtime_error("'CAMERA_TRANSPORT' TCP is not supported, switch the serial gateway to UDP.");
+            } else if (transportString != "UDP") {
+                throw std::runtime_error(QString("Unknown camera transport: %1").arg(transportString).toStdString());
+            }
+        }
+
         camera.MIN_ZOOM_SPEED = cameraObject["MIN_ZOOM_SPEED"].toInt();
         camera.MAX_ZOOM_SPEED = cameraObject["MAX_ZOOM_SPEED"].toInt();
         camera.MIN_PAN_SPEED = cameraObject["MIN_PAN_SPEED"].toInt();
@@ -97,6 +138,33 @@ void CVCSettings::parseJSON(const QString& filename) {
         camera.MAX_FOCUS_SPEED = cameraObject["MAX_FOCUS_SPEED"].toInt();
         camera.MIN_PRESET_NO = cameraObject["MIN_PRESET_NO"].toInt();
         camera.MAX_PRESET_NO = cameraObject["MAX_PRESET_NO"].toInt();
+        camera.HOST_PRESET = cameraObject["HOST_PRESET"].toBool(false);
+        camera.PRESET_SPEED = cameraObject["PRESET_SPEED"].toInt(camera.MAX_PAN_SPEED);
+        if (camera.HOST_PRESET && camera.isPelco()) {
+            throw std::runtime_error("'HOST_PRESET' needs position inquiries, which Pelco cameras do not have.");
+        }
+
+        // Stick response curves
+        camera.STICK_DEADZONE = cameraObject["STICK_DEADZONE"].toDouble(camera.STICK_DEADZONE);
+        camera.STICK_EXPO = cameraObject["STICK_EXPO"].toDouble(camera.STICK_EXPO);
+        if (camera.STICK_DEADZONE < 0 || camera.STICK_DEADZONE >= 1) {
+            throw std::runtime_error("'STICK_DEADZONE' must be between 0 and 1.");
+        }
+        if (camera.STICK_EXPO < 0 || camera.STICK_EXPO > 1) {
+            throw std::runtime_error("'STICK_EXPO' must be between 0 and 1.");
+        }
+        camera.PAN_CURVE.build(camera.STICK_DEADZONE, camera.STICK_EXPO, camera.MIN_PAN_SPEED, camera.MAX_PAN_SPEED);
+        camera.TILT_CURVE.build(camera.STICK_DEADZONE, camera.STICK_EXPO, camera.MIN_TILT_SPEED, camera.MAX_TILT_SPEED);
+        camera.ZOOM_CURVE.build(camera.STICK_DEADZONE, camera.STICK_EXPO, camera.MIN_ZOOM_SPEED, camera.MAX_ZOOM_SPEED);
+
+        // Cameras naming the same serial port share one line, whose framing is either VISCA or Pelco
+        for (const CameraSettings& other : CAMERAS) {
+            if (camera.isSerial() && other.isSerial() && other.CAMERA_HOST == camera.CAMERA_HOST &&
+                    other.isPelco() != camera.isPelco()) {
+                throw std::runtime_error(QString("VISCA and Pelco cameras cannot share serial port %1.")
+                        .arg(camera.CAMERA_HOST).toStdString());
+            }
+        }
 
         CAMERAS.push_back(camera);
     }
@@ -118,6 +186,42 @@ void CVCSettings::parseJSON(const QString& filename) {
         STREAM_DECK.STREAM_DECK_PORT = streamDeckObject["STREAM_DECK_PORT"].toInt();
     }
 
+    // Parse gamepad settings if the section is present
+    if (root.contains("GAMEPAD")) {
+        QJsonObject gamepadObject = root["GAMEPAD"].toObject();
+        if (gamepadObject.contains("CONTROL_RATE_HZ")) {
+            int rate = gamepadObject["CONTROL_RATE_HZ"].toInt();
+            if (rate <= 0 || rate > 1000) {
+                throw std::runtime_error("'CONTROL_RATE_HZ' must be between 1 and 1000.");
+            }
+            GAMEPAD.CONTROL_RATE_HZ = rate;
+        }
+    }
+
+    // Parse camera I/O settings if the section is present
+    if (root.contains("CAMERA_IO")) {
+        QJsonObject cameraIoObject = root["CAMERA_IO"].toObject();
+        if (cameraIoObject.contains("THREAD_PRIORITY")) {
+            QString priority = cameraIoObject["THREAD_PRIORITY"].toString();
+            if (priority == "NORMAL") {
+                CAMERA_IO.THREAD_PRIORITY = CameraIoSettings::Priority::NORMAL;
+            } else if (priority == "HIGH") {
+                CAMERA_IO.THREAD_PRIORITY = CameraIoSettings::Priority::HIGH;
+            } else if (priority == "TIME_CRITICAL") {
+                CAMERA_IO.THREAD_PRIORITY = CameraIoSettings::Priority::TIME_CRITICAL;
+            } else {
+                throw std::runtime_error("'THREAD_PRIORITY' must be NORMAL, HIGH or TIME_CRITICAL.");
+            }
+        }
+        if (cameraIoObject.contains("MOTION_WATCHDOG_MS")) {
+            int window = cameraIoObject["MOTION_WATCHDOG_MS"].toInt(-1);
+            if (window < 0 || window > 60000) {
+                throw std::runtime_error("'MOTION_WATCHDOG_MS' must be between 0 and 60000.");
+            }
+            CAMERA_IO.MOTION_WATCHDOG_MS = window;
+        }
+    }
+
     // Parse Matrix settings if the section is present
     if (root.contains("MATRIX")) {
         MATRIX.enabled = true;  // Set enabled flag when Matrix section exists
@@ -358,16 +462,16 @@ void CVCSettings::parseJSON(const QString& filename) {
                     QJsonObject overrideObject = ruleObject["OBS_SCENE_OVERRIDE_LIST"].toObject();
                     for (auto it = overrideObject.begin(); it != overrideObject.end(); ++it) {
                         bool key_ok;
-                        uint_fast8_t key = it.key().toUInt(&key_ok);
-                        if (!key_ok) {
-                            throw std::runtime_error("Invalid key in OBS_SCENE_OVERRIDE_LIST: '" + it.key().toStdString() + "'. Must be an integer string.");
+                        unsigned key = it.key().toUInt(&key_ok);
+                        if (!key_ok || key > OBSSettings::MAX_SCENE_ID) {
+                            throw std::runtime_error("Invalid key in OBS_SCENE_OVERRIDE_LIST: '" + it.key().toStdString() + "'. Must be a scene number up to " + std::to_string(OBSSettings::MAX_SCENE_ID) + ".");
                         }
 
                         bool value_ok;
-                        uint_fast8_t value = it.value().toVariant().toUInt(&value_ok);
+                        unsigned value = it.value().toVariant().toUInt(&value_ok);
 
-                        if (!value_ok) {
-                            throw std::runtime_error("Invalid value for key '" + it.key().toStdString() + "' in OBS_SCENE_OVERRIDE_LIST. Must be an unsigned integer that fits in uint_fast8_t.");
+                        if (!value_ok || value > OBSSettings::MAX_SCENE_ID) {
+                            throw std::runtime_error("Invalid value for key '" + it.key().toStdString() + "' in OBS_SCENE_OVERRIDE_LIST. Must be a scene number up to " + std::to_string(OBSSettings::MAX_SCENE_ID) + ".");
                         }
                         rule.OBS_SCENE_OVERRIDE_LIST[key] = value;
                     }
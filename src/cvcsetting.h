@@ -2,11 +2,15 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <unordered_map>
 #include <QString>
+#include "stickcurve.h"
 
 struct OBSSettings {
+    static constexpr uint16_t MAX_SCENE_ID = 999;   //scenes are named "<sceneId>[.<camId>] ..."
+
     QString OBS_HOST;
     int     OBS_PORT;
 };
@@ -14,12 +18,18 @@ struct OBSSettings {
 struct CameraSettings {
     enum class Protocal {
         VISCA_STRICT,
-        VISCA_LOOSE
+        VISCA_LOOSE,
+        VISCA_SERIAL,   //RS-232/RS-422, CAMERA_HOST is the serial port
+        PELCO_D,        //serial port, or a UDP gateway if CAMERA_PORT is set
+        PELCO_P
     };
     int      CAMERA_ID;
     QString  CAMERA_HOST;
-    uint16_t CAMERA_PORT;
+    uint16_t CAMERA_PORT = 0;
     Protocal CAMERA_PROTOCAL;
+    unsigned VISCA_ADDRESS = 1;     //position in the daisy chain of a serial line
+    unsigned PELCO_ADDRESS = 1;
+    unsigned SERIAL_BAUD = 9600;
     unsigned MIN_ZOOM_SPEED;
     unsigned MAX_ZOOM_SPEED;
     unsigned MIN_PAN_SPEED;
@@ -30,6 +40,18 @@ struct CameraSettings {
     unsigned MAX_FOCUS_SPEED;
     unsigned MIN_PRESET_NO;
     unsigned MAX_PRESET_NO;
+    bool     HOST_PRESET = false;   //presets are absolute positions stored on the host
+    unsigned PRESET_SPEED;          //pan/tilt speed of host preset recall
+    double   STICK_DEADZONE = 0.05;
+    double   STICK_EXPO = 0.0;
+
+    bool isPelco() const { return CAMERA_PROTOCAL == Protocal::PELCO_D || CAMERA_PROTOCAL == Protocal::PELCO_P; }
+    bool isSerial() const { return CAMERA_PROTOCAL == Protocal::VISCA_SERIAL || (isPelco() && CAMERA_PORT == 0); }
+
+    // Built from the settings above when they are loaded
+    StickCurve PAN_CURVE;
+    StickCurve TILT_CURVE;
+    StickCurve ZOOM_CURVE;
 };
 
 struct StreamDeckSettings {
@@ -38,6 +60,20 @@ struct StreamDeckSettings {
 
 };
 
+struct GamepadSettings {
+    unsigned CONTROL_RATE_HZ = 60;  //gamepad sampling rate of the camera control loop
+};
+
+struct CameraIoSettings {
+    enum class Priority {
+        NORMAL,
+        HIGH,
+        TIME_CRITICAL
+    };
+    Priority THREAD_PRIORITY = Priority::NORMAL;   //scheduling priority of the camera I/O thread
+    unsigned MOTION_WATCHDOG_MS = 500;  //a moving camera is stopped without fresh intent for this long, 0 = off
+};
+
 struct MatrixPort {
     QString  NAME;
     unsigned PORT;
@@ -56,7 +92,7 @@ struct CustomRule {
     unsigned OUTPUT_IDX;
 
     // Actions
-    std::unordered_map<uint_fast8_t, uint_fast8_t> OBS_SCENE_OVERRIDE_LIST;
+    std::unordered_map<uint16_t, uint16_t> OBS_SCENE_OVERRIDE_LIST;
     bool OBS_SCENE_OVERRIDE_CLEAR = false;
 };
 
@@ -83,6 +119,8 @@ struct CVCSettings {
     OBSSettings OBS;
     std::vector<CameraSettings> CAMERAS;
     StreamDeckSettings STREAM_DECK;
+    GamepadSettings GAMEPAD;
+    CameraIoSettings CAMERA_IO;
     MatrixSettings MATRIX;
 
     void parseJSON(const QString& filename); //throw exception when error
@@ -19,7 +19,7 @@ class MatrixConnect : public QNetworkAccessManager {
         void updateStatus(const QString& msg);
         void connectionFailed();
         void mappingUpdated(const std::unordered_map<unsigned, std::vector<unsigned>>& mapping);
-        void addOBSSceneOverrides(const std::unordered_map<uint_fast8_t, uint_fast8_t>& overrides);
+        void addOBSSceneOverrides(const std::unordered_map<uint16_t, uint16_t>& overrides);
         void clearOBSSceneOverrides();
 
     public slots:
@@ -3,7 +3,10 @@
 #include "obsconnect.h"
 #include <stdio.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include <QTimer>
+#include <QRandomGenerator>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -13,35 +16,122 @@ OBSConnect::OBSConnect(const OBSSettings& obsSettings)
     : QWebSocket(), settings(obsSettings)
 {
     connect(this, &QWebSocket::connected, this, [this]() { emit updateStatus("OBS connecting."); });
-    connect(this, &QWebSocket::disconnected, this, [this]() { emit updateStatus("OBS disconnected."); connectOBS(); });
+    connect(this, &QWebSocket::disconnected, this, [this]() { emit updateStatus("OBS disconnected."); failAll(); connectOBS(); });
     connect(this, &QWebSocket::textMessageReceived, this, &OBSConnect::processOBSMsg);
 
-    connectOBS();
-}
+    timeoutTimer = new QTimer(this);
+    timeoutTimer->setInterval(TIMEOUT_CHECK_MS);
+    connect(timeoutTimer, &QTimer::timeout, this, &OBSConnect::checkTimeouts);
 
-void OBSConnect::connectOBS()
-{
-    QTimer::singleShot( 5000, this, [this] () {
+    reconnectTimer = new QTimer(this);
+    reconnectTimer->setSingleShot(true);
+    connect(reconnectTimer, &QTimer::timeout, this, [this] () {
         QUrl url;
         url.setScheme("ws");
         url.setHost(settings.OBS_HOST);
         url.setPort(settings.OBS_PORT);
         open(url);
     });
+
+    connectOBS();
+}
+
+void OBSConnect::connectOBS()
+{
+    if (reconnectTimer->isActive()) return;
+    //Right away the first time, so a restarted OBS is back in control at once.
+    //Then backed off with jitter, so a busy or starting OBS is not hammered.
+    int delayMs = 0;
+    if (reconnectCount > 0) {
+        int backoffMs = std::min(int(RECONNECT_MAX_MS), int(RECONNECT_MIN_MS) << std::min(reconnectCount - 1, 8));
+        delayMs = backoffMs / 2 + QRandomGenerator::global()->bounded(backoffMs / 2 + 1);
+    }
+    reconnectCount++;
+    reconnectTimer->start(delayMs);
 }
 
-void OBSConnect::sendRequest(const char* requestType, QJsonObject&& requestData)
+void OBSConnect::sendRequest(const char* requestType, QJsonObject&& requestData, ResponseHandler&& onResponse)
 {
-    static int requestId = 0;
-    sendRequest(6, //op = Request
+    sendTracked(6, //op = Request
         QJsonObject {
             {"requestType", requestType},
             {"requestId", ++requestId},
             {"requestData", std::move(requestData)}
-        }
+        },
+        std::move(onResponse)
     );
 }
 
+void OBSConnect::sendTracked(const int op, QJsonObject&& d, ResponseHandler&& onResponse)
+{
+    //Requests leave in order, so nothing overtakes the ones already waiting
+    if (inFlight.size() >= MAX_IN_FLIGHT || !waiting.empty()) {
+        waiting.push_back(Waiting{op, std::move(d), std::move(onResponse)});
+        return;
+    }
+    InFlight& r = inFlight[d["requestId"].toInt()];
+    r.onResponse = std::move(onResponse);
+    r.sentAt.start();
+    sendRequest(op, std::move(d));
+    if (!timeoutTimer->isActive()) timeoutTimer->start();
+}
+
+void OBSConnect::sendWaiting()
+{
+    while (!waiting.empty() && inFlight.size() < MAX_IN_FLIGHT) {
+        Waiting w = std::move(waiting.front());
+        waiting.pop_front();
+        InFlight& r = inFlight[w.d["requestId"].toInt()];
+        r.onResponse = std::move(w.onResponse);
+        r.sentAt.start();
+        sendRequest(w.op, std::move(w.d));
+    }
+    if (!inFlight.empty() && !timeoutTimer->isActive()) timeoutTimer->start();
+}
+
+void OBSConnect::complete(int id, Response&& response)
+{
+    auto iter = inFlight.find(id);
+    if (iter == inFlight.end()) return; //timed out already
+    response.latencyUs = iter->second.sentAt.nsecsElapsed() / 1000;
+    ResponseHandler onResponse = std::move(iter->second.onResponse);
+    inFlight.erase(iter);
+    if (inFlight.empty()) timeoutTimer->stop();
+    sendWaiting();
+    //Last, the handler may send the next request
+    if (onResponse) onResponse(response);
+}
+
+void OBSConnect::checkTimeouts()
+{
+    std::vector<int> expired;
+    for (const auto& r : inFlight) {
+        if (r.second.sentAt.hasExpired(REQUEST_TIMEOUT_MS)) expired.push_back(r.first);
+    }
+    if (!expired.empty()) emit updateStatus("OBS request timed out.");
+    for (int id : expired) {
+        Response response;
+        response.isTimeout = true;
+        complete(id, std::move(response));
+    }
+}
+
+void OBSConnect::failAll()
+{
+    std::unordered_map<int, InFlight> sent;
+    sent.swap(inFlight);
+    std::deque<Waiting> unsent;
+    unsent.swap(waiting);
+    timeoutTimer->stop();
+    Response response;
+    for (auto& r : sent) {
+        if (r.second.onResponse) r.second.onResponse(response);
+    }
+    for (Waiting& w : unsent) {
+        if (w.onResponse) w.onResponse(response);
+    }
+}
+
 void OBSConnect::sendRequest(const int op, QJsonObject&& d)
 {
     QJsonObject request {
@@ -52,9 +142,111 @@ void OBSConnect::sendRequest(const int op, QJsonObject&& d)
     sendTextMessage (QString::fromUtf8 (QJsonDocument(request).toJson(QJsonDocument::Compact)));
 }
 
+OBSConnect::Batch OBSConnect::batch(Batch::Execution execution)
+{
+    return Batch(*this, execution);
+}
+
+OBSConnect::Batch& OBSConnect::Batch::add(const char* requestType, QJsonObject&& requestData)
+{
+    requests.append(QJsonObject {
+        {"requestType", requestType},
+        {"requestData", std::move(requestData)}
+    });
+    return *this;
+}
+
+OBSConnect::Batch& OBSConnect::Batch::sleep(int n)
+{
+    return add("Sleep", QJsonObject{{execution == Execution::SERIAL_FRAME? "sleepFrames" : "sleepMillis", n}});
+}
+
+OBSConnect::Batch& OBSConnect::Batch::haltOnFailure()
+{
+    isHaltOnFailure = true;
+    return *this;
+}
+
+void OBSConnect::Batch::send(ResponseHandler&& onResponse)
+{
+    if (requests.isEmpty()) return;
+    obs.sendTracked(8, //op = RequestBatch
+        QJsonObject {
+            {"requestId", ++obs.requestId},
+            {"haltOnFailure", isHaltOnFailure},
+            {"executionType", static_cast<int>(execution)},
+            {"requests", std::move(requests)}
+        },
+        std::move(onResponse)
+    );
+    requests = QJsonArray();
+}
+
+//EventSubscription bits of obs-websocket
+enum : unsigned { SUBSCRIBE_SCENES = 4, SUBSCRIBE_UI = 1024 };
+
+const OBSConnect::EventHandler OBSConnect::EVENT_HANDLERS[] = {
+    {"CurrentProgramSceneChanged", SUBSCRIBE_SCENES, &OBSConnect::onCurrentSceneChanged},
+    {"CurrentPreviewSceneChanged", SUBSCRIBE_SCENES, &OBSConnect::onCurrentSceneChanged},
+    {"StudioModeStateChanged",     SUBSCRIBE_UI,     &OBSConnect::onStudioModeStateChanged},
+    {"SceneCreated",               SUBSCRIBE_SCENES, &OBSConnect::onSceneCreated},
+    {"SceneRemoved",               SUBSCRIBE_SCENES, &OBSConnect::onSceneRemoved},
+    {"SceneNameChanged",           SUBSCRIBE_SCENES, &OBSConnect::onSceneNameChanged},
+    {nullptr, 0, nullptr}
+};
+
+//Only the categories with a handler, so OBS does not send what would be dropped
+unsigned OBSConnect::eventSubscriptions()
+{
+    unsigned mask = 0;
+    for (const EventHandler* h = EVENT_HANDLERS; h->eventType; h++) mask |= h->subscription;
+    return mask;
+}
+
+const OBSConnect::EventHandler* OBSConnect::findEventHandler(const QStringRef& eventType)
+{
+    for (const EventHandler* h = EVENT_HANDLERS; h->eventType; h++) {
+        if (eventType == QLatin1String(h->eventType)) return h;
+    }
+    return nullptr;
+}
+
+//OBS sends compact JSON with sorted keys, so the top level "op" and the "eventType" of "d"
+//are the last occurrences of their keys. Both scans return nothing if the text looks different.
+int OBSConnect::scanOp(const QString& msg)
+{
+    static const QLatin1String KEY("\"op\":");
+    int i = msg.lastIndexOf(KEY);
+    if (i < 0) return -1;
+    int op = -1;
+    for (i += KEY.size(); i < msg.size() && msg[i].isDigit(); i++) op = (op < 0? 0 : op * 10) + msg[i].digitValue();
+    return op;
+}
+
+QStringRef OBSConnect::scanEventType(const QString& msg)
+{
+    static const QLatin1String KEY("\"eventType\":\"");
+    int begin = msg.lastIndexOf(KEY);
+    if (begin < 0) return QStringRef();
+    begin += KEY.size();
+    int end = msg.indexOf(QChar('"'), begin);
+    if (end < 0) return QStringRef();
+    return msg.midRef(begin, end - begin);
+}
+
 void OBSConnect::processOBSMsg(const QString& msg)
 {
     //std::cout << "msg: " << msg.toStdString() << std::endl;
+    //Events without a handler are dropped before the message is parsed
+    const EventHandler* handler = nullptr;
+    if (scanOp(msg) == 5) {
+        QStringRef eventType = scanEventType(msg);
+        if (!eventType.isNull()) {
+            handler = findEventHandler(eventType);
+            if (!handler) return;
+        }
+    }
+
     QJsonDocument json = QJsonDocument::fromJson(msg.toUtf8());
     if (json.isNull()) return;
 
@@ -64,7 +256,7 @@ void OBSConnect::processOBSMsg(const QString& msg)
                 sendRequest (1, //op = Identify
                     QJsonObject {
                         {"rpcVersion", 1},
-                        {"eventSubscriptions", 4 | 1024} //4 - Scenes Events, 1024 - UI Events
+                        {"eventSubscriptions", static_cast<int>(eventSubscriptions())}
                     });
                 emit updateStatus("OBS connecting..");
                 break;
@@ -72,41 +264,25 @@ void OBSConnect::processOBSMsg(const QString& msg)
 
         case 2: //Identified
             {
-                sendRequest("GetStudioModeEnabled");
-                sendRequest("GetSceneList");
+                reconnectCount = 0;
+                batch(Batch::Execution::SERIAL_REALTIME).add("GetStudioModeEnabled").add("GetSceneList").send();
                 emit updateStatus("OBS connected.");
                 break;
             }
 
         case 5: //Event
             {
-                QString eventType = json["d"]["eventType"].toString();
-                if (eventType == "CurrentProgramSceneChanged" || eventType == "CurrentPreviewSceneChanged") {
-                    QString sceneName = json["d"]["eventData"]["sceneName"].toString();
-                    auto sId = getSceneIdFromName(sceneName);
-                    emit updateStatus("Current Scene: " + sceneName);
-                    emit currentSceneChanged(sId.first, sId.second);
-
-                } else if (eventType == "StudioModeStateChanged") {
-                    isStudioMode = json["d"]["eventData"]["studioModeEnabled"].toBool();
-                    emit studioModeChanged(isStudioMode);
-
-                } else if (eventType == "SceneCreated") {
-                    createScene(json["d"]["eventData"]["sceneName"].toString());
-
-                } else if (eventType == "SceneRemoved") {
-                    removeScene(json["d"]["eventData"]["sceneName"].toString());
-
-                } else if (eventType == "SceneNameChanged") {
-                    removeScene(json["d"]["eventData"]["oldSceneName"].toString());
-                    createScene(json["d"]["eventData"]["sceneName"].toString());
+                if (!handler) {
+                    //The scan did not find the type
+                    QString eventType = json["d"]["eventType"].toString();
+                    handler = findEventHandler(QStringRef(&eventType));
                 }
+                if (handler) (this->*handler->handle)(json["d"]["eventData"].toObject());
 #if 0
                 std::cout << "---\n";
-                for (const auto& p1 : sceneMap) {
-                    for (const auto& p2: p1.second) {
-                        std::cout << "SceneId: " << (int)p1.first << " CamId: " << (int)p2.first << " SceneName: " << p2.second.toStdString() << std::endl;
-                    }
+                for (size_t i = 0; i < sceneTable.size(); i++) {
+                    if (sceneTable[i].isEmpty()) continue;
+                    std::cout << "SceneId: " << i / camSlots << " CamId: " << i % camSlots << " SceneName: " << sceneTable[i].toStdString() << std::endl;
                 }
                 std::cout << "---\n";
 #endif
@@ -115,40 +291,125 @@ void OBSConnect::processOBSMsg(const QString& msg)
 
         case 7: //RequestResponse
             {
-                if (json["d"]["requestType"].toString() == "GetSceneList") {
-                    processSceneList(json["d"]["responseData"]["scenes"].toArray());
-                    QString previewSceneName = json["d"]["responseData"]["currentPreviewSceneName"].toString();
-                    QString programSceneName = json["d"]["responseData"]["currentProgramSceneName"].toString();
-                    auto sId = getSceneIdFromName(previewSceneName.isEmpty()? programSceneName : previewSceneName);
-                    emit currentSceneChanged(sId.first, sId.second);
-
-                } else if (json["d"]["requestType"].toString() == "GetStudioModeEnabled") {
-                    isStudioMode = json["d"]["responseData"]["studioModeEnabled"].toBool();
-                    emit studioModeChanged(isStudioMode);
+                QJsonObject d = json["d"].toObject();
+                processResponse(d);
+                Response response;
+                response.isOk = d["requestStatus"]["result"].toBool();
+                response.code = d["requestStatus"]["code"].toInt();
+                response.comment = d["requestStatus"]["comment"].toString();
+                response.data = d["responseData"].toObject();
+                complete(d["requestId"].toInt(), std::move(response));
+                break;
+            }
+
+        case 9: //RequestBatchResponse, the results in request order
+            {
+                QJsonObject d = json["d"].toObject();
+                int id = d["requestId"].toInt();
+                Response response;
+                response.isOk = true;
+                for (QJsonValueRef result : d["results"].toArray()) {
+                    QJsonObject r = result.toObject();
+                    processResponse(r);
+                    if (!r["requestStatus"]["result"].toBool() && response.isOk) {
+                        response.isOk = false;
+                        response.code = r["requestStatus"]["code"].toInt();
+                        response.comment = r["requestStatus"]["comment"].toString();
+                    }
                 }
+                response.data = std::move(d);
+                complete(id, std::move(response));
                 break;
             }
     };
 }
 
+void OBSConnect::onCurrentSceneChanged(const QJsonObject& eventData)
+{
+    QString sceneName = eventData["sceneName"].toString();
+    emit updateStatus("Current Scene: " + sceneName);
+    setCurrentScene(getSceneIdFromName(sceneName));
+}
+
+void OBSConnect::onStudioModeStateChanged(const QJsonObject& eventData)
+{
+    setStudioMode(eventData["studioModeEnabled"].toBool());
+}
+
+void OBSConnect::onSceneCreated(const QJsonObject& eventData)
+{
+    createScene(eventData["sceneName"].toString());
+}
+
+void OBSConnect::onSceneRemoved(const QJsonObject& eventData)
+{
+    removeScene(eventData["sceneName"].toString());
+}
+
+void OBSConnect::onSceneNameChanged(const QJsonObject& eventData)
+{
+    removeScene(eventData["oldSceneName"].toString());
+    createScene(eventData["sceneName"].toString());
+}
+
+void OBSConnect::processResponse(const QJsonObject& d)
+{
+    if (d["requestType"].toString() == "GetSceneList") {
+        processSceneList(d["responseData"]["scenes"].toArray());
+        QString previewSceneName = d["responseData"]["currentPreviewSceneName"].toString();
+        QString programSceneName = d["responseData"]["currentProgramSceneName"].toString();
+        auto sId = getSceneIdFromName(previewSceneName.isEmpty()? programSceneName : previewSceneName);
+        if (!hasCurrentScene || sId != currentScene) setCurrentScene(sId);
+
+    } else if (d["requestType"].toString() == "GetStudioModeEnabled") {
+        bool en = d["responseData"]["studioModeEnabled"].toBool();
+        if (!hasStudioMode || en != isStudioMode) setStudioMode(en);
+    }
+}
+
+void OBSConnect::setCurrentScene(std::pair<uint16_t, uint_fast8_t> sceneId)
+{
+    currentScene = sceneId;
+    hasCurrentScene = true;
+    emit currentSceneChanged(sceneId.first, sceneId.second);
+}
+
+void OBSConnect::setStudioMode(bool en)
+{
+    isStudioMode = en;
+    hasStudioMode = true;
+    emit studioModeChanged(isStudioMode);
+}
+
+//Also the resync after a reconnect, so only scenes added or removed meanwhile touch the index
 void OBSConnect::processSceneList(QJsonArray&& sceneList)
 {
-    sceneMap.clear();
+    QSet<QString> listed;
+    for (QJsonValueRef scene: sceneList) listed.insert(scene.toObject()["sceneName"].toString());
+    //Removed first, so a scene sharing the ids of a removed one can take them
+    std::vector<QString> removed;
+    for (auto iter = sceneIds.constBegin(); iter != sceneIds.constEnd(); ++iter) {
+        if (!listed.contains(iter.key())) removed.push_back(iter.key());
+    }
+    bool isChanged = false;
+    for (const QString& sceneName : removed) isChanged |= eraseScene(sceneName);
     for (QJsonValueRef scene: sceneList) {
-        createScene (scene.toObject()["sceneName"].toString());
+        QString sceneName = scene.toObject()["sceneName"].toString();
+        if (!sceneIds.contains(sceneName)) isChanged |= insertScene(std::move(sceneName));
     }
+    if (isChanged) updateNeighbours();
 }
 
-std::pair<uint_fast8_t,uint_fast8_t> OBSConnect::getSceneIdFromName(const QString& sceneName)
+std::pair<uint16_t,uint_fast8_t> OBSConnect::parseSceneName(const QString& sceneName)
 {
+    static const unsigned MAX_NUM[2] = {OBSSettings::MAX_SCENE_ID, 0xff};
     int nNum = 0;
-    uint_fast8_t num[2] = {0, 0};
+    unsigned num[2] = {0, 0};
     for (const QChar& c : sceneName) {
         int d = c.digitValue();
         if (d >= 0) {
-            uint_fast8_t newNum = num[nNum]*10+d;
-            if (newNum < num[nNum]) return {0,0}; //overflow
-            num[nNum] = newNum;
+            num[nNum] = num[nNum]*10+d;
+            if (num[nNum] > MAX_NUM[nNum]) return {0,0}; //out of range
         } else {
             if (nNum == 0 && c == '.') {
                 nNum = 1;
@@ -157,47 +418,119 @@ std::pair<uint_fast8_t,uint_fast8_t> OBSConnect::getSceneIdFromName(const QStrin
             }
         }
     }
-    return {num[0],num[1]};
+    return {static_cast<uint16_t>(num[0]), static_cast<uint_fast8_t>(num[1])};
+}
+
+std::pair<uint16_t,uint_fast8_t> OBSConnect::getSceneIdFromName(const QString& sceneName) const
+{
+    auto iter = sceneIds.constFind(sceneName);
+    if (iter != sceneIds.constEnd()) return {iter.value().sceneId, iter.value().camId};
+    return parseSceneName(sceneName); //not listed yet
+}
+
+bool OBSConnect::insertScene(QString&& sceneName)
+{
+    uint16_t sceneId;
+    uint_fast8_t camId;
+    std::tie(sceneId, camId) = parseSceneName(sceneName);
+    if (sceneId == 0) return false;
+
+    if (sceneId >= sceneRows || camId >= camSlots) {
+        //Grow the table, scene numbers are small and new ones are rare
+        size_t rows = std::max<size_t>(sceneRows, sceneId + 1);
+        size_t cams = std::max<size_t>(camSlots, camId + 1);
+        std::vector<QString> table(rows * cams);
+        for (size_t i = 0; i < sceneTable.size(); i++) {
+            table[i / camSlots * cams + i % camSlots] = std::move(sceneTable[i]);
+        }
+        sceneTable.swap(table);
+        sceneRows = rows;
+        camSlots = cams;
+        scenePresent.resize((rows + 63) / 64);
+    }
+    QString& slot = sceneTable[sceneId * camSlots + camId];
+    sceneIds.insert(sceneName, SceneKey{sceneId, camId});
+    if (!slot.isEmpty()) {
+        //Same ids, the first name keeps them and this one takes over when it goes away
+        qWarning("OBS scene \"%s\" has the same scene and camera no. as \"%s\", ignored.", sceneName.toUtf8().constData(),
+                slot.toUtf8().constData());
+        return false;
+    }
+    slot = std::move(sceneName);
+    scenePresent[sceneId / 64] |= uint64_t(1) << (sceneId % 64);
+    return true;
 }
 
 void OBSConnect::createScene(QString&& sceneName)
 {
-    uint_fast8_t sceneId, camId;
-    std::tie(sceneId, camId) = getSceneIdFromName(sceneName);
-    if (sceneId == 0) return;
-    sceneMap[sceneId][camId] = std::move(sceneName);
-    //std::cout << "SceneId: " << (int)sceneId << " CamId: " << (int)camId << " SceneName: " << sceneMap[sceneId][camId].toStdString() << std::endl;
+    if (insertScene(std::move(sceneName))) updateNeighbours();
 }
 
 void OBSConnect::removeScene(const QString& sceneName)
 {
-    uint_fast8_t sceneId, camId;
-    std::tie(sceneId, camId) = getSceneIdFromName(sceneName);
-    auto iter1 = sceneMap.find(sceneId);
-    if (iter1 != sceneMap.end()) {
-        auto iter2 = iter1->second.find(camId);
-        if (iter2 != iter1->second.end())
-            iter1->second.erase(iter2);
-        if (iter1->second.empty()) 
-            sceneMap.erase(iter1);
+    if (eraseScene(sceneName)) updateNeighbours();
+}
+
+bool OBSConnect::eraseScene(const QString& sceneName)
+{
+    auto iter = sceneIds.find(sceneName);
+    if (iter == sceneIds.end()) return false;
+    SceneKey key = iter.value();
+    sceneIds.erase(iter);
+
+    QString* row = &sceneTable[key.sceneId * camSlots];
+    if (row[key.camId] != sceneName) return false; //an ignored duplicate
+    row[key.camId].clear();
+    for (auto dup = sceneIds.constBegin(); dup != sceneIds.constEnd(); ++dup) {
+        if (dup.value().sceneId != key.sceneId || dup.value().camId != key.camId) continue;
+        row[key.camId] = dup.key();
+        return false; //the scene is still there under the other name
+    }
+    for (size_t i = 0; i < camSlots; i++) {
+        if (!row[i].isEmpty()) return true; //other cameras still have the scene
+    }
+    scenePresent[key.sceneId / 64] &= ~(uint64_t(1) << (key.sceneId % 64));
+    return true;
+}
+
+void OBSConnect::updateNeighbours()
+{
+    //One extra entry, for asking about the scene after the last one
+    prevScene.assign(sceneRows + 1, 0);
+    nextScene.assign(sceneRows + 1, 0);
+    uint16_t prev = 0;
+    for (size_t i = 0; i <= sceneRows; i++) {
+        prevScene[i] = prev;
+        if (i < sceneRows && isScenePresent(i)) prev = static_cast<uint16_t>(i);
+    }
+    uint16_t next = 0;
+    for (size_t i = sceneRows + 1; i-- > 0; ) {
+        nextScene[i] = next;
+        if (i < sceneRows && isScenePresent(i)) next = static_cast<uint16_t>(i);
     }
 }
 
-void OBSConnect::switchToScene(uint_fast8_t sceneId, uint_fast8_t camId)
+const QString* OBSConnect::findScene(uint16_t sceneId, uint_fast8_t camId) const
+{
+    if (sceneId >= sceneRows || camId >= camSlots) return nullptr;
+    const QString& sceneName = sceneTable[sceneId * camSlots + camId];
+    return sceneName.isEmpty()? nullptr : &sceneName;
+}
+
+void OBSConnect::switchToScene(uint16_t sceneId, uint_fast8_t camId)
 {
     auto iterOverride = sceneIdOverride.find(sceneId);
     if (iterOverride != sceneIdOverride.end())
         sceneId = iterOverride->second;
 
-    auto iter1 = sceneMap.find(sceneId);
-    if (iter1 != sceneMap.end()) {
-        auto iter2 = iter1->second.find(camId);
-        if (iter2 == iter1->second.end())
-            iter2 = iter1->second.find(0);
-        if (iter2 != iter1->second.end()) {
-            sendRequest(isStudioMode? "SetCurrentPreviewScene" : "SetCurrentProgramScene", QJsonObject{{"sceneName", iter2->second}});
-            return;
-        }
+    const QString* sceneName = findScene(sceneId, camId);
+    if (!sceneName) sceneName = findScene(sceneId, 0);
+    if (sceneName) {
+        sendRequest(isStudioMode? "SetCurrentPreviewScene" : "SetCurrentProgramScene", QJsonObject{{"sceneName", *sceneName}},
+            [this](const Response& response) {
+                if (!response.isOk && response.code != 0) emit updateStatus("Scene switch failed: " + response.comment);
+            });
+        return;
     }
     emit updateStatus("Scene " + QString::number(sceneId) + '.' + QString::number(camId) + " not existed.");
 }
@@ -207,27 +540,18 @@ void OBSConnect::switchStudioMode()
     sendRequest("SetStudioModeEnabled", QJsonObject{{"studioModeEnabled", !isStudioMode}});
 }
 
-uint_fast8_t OBSConnect::getPrevSceneId(uint_fast8_t sceneId) const
+uint16_t OBSConnect::getPrevSceneId(uint16_t sceneId) const
 {
-    decltype(sceneMap)::const_reverse_iterator iter(sceneMap.lower_bound(sceneId));
-    if (iter == sceneMap.rend()) {
-        return 0;
-    } else {
-        return iter->first;
-    }
+    if (prevScene.empty()) return 0;
+    return prevScene[std::min<size_t>(sceneId, prevScene.size() - 1)];
 }
 
-uint_fast8_t OBSConnect::getNextSceneId(uint_fast8_t sceneId) const
+uint16_t OBSConnect::getNextSceneId(uint16_t sceneId) const
 {
-    decltype(sceneMap)::const_iterator iter(sceneMap.upper_bound(sceneId));
-    if (iter == sceneMap.end()) {
-        return 0;
-    } else {
-        return iter->first;
-    }
+    return sceneId < nextScene.size()? nextScene[sceneId] : 0;
 }
 
-void OBSConnect::addSceneOverrides(const std::unordered_map<uint_fast8_t, uint_fast8_t>& overrides)
+void OBSConnect::addSceneOverrides(const std::unordered_map<uint16_t, uint16_t>& overrides)
 {
     for (const auto& pair : overrides) {
         sceneIdOverride[pair.first] = pair.second;
@@ -2,13 +2,19 @@
 
 #pragma once
 
-#include <map>
+#include <vector>
 #include <unordered_map>
+#include <deque>
+#include <functional>
 #include <QWebSocket>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
 #include <QJsonObject>
+#include <QJsonArray>
 
 QT_BEGIN_NAMESPACE
-class QJsonArray;
+class QTimer;
 QT_END_NAMESPACE
 
 class OBSSettings;
@@ -19,41 +25,151 @@ class OBSConnect : public QWebSocket {
         OBSConnect(const OBSSettings&);
         virtual ~OBSConnect() {}
 
-        void switchToScene(uint_fast8_t sceneId, uint_fast8_t camId);
+        static constexpr int REQUEST_TIMEOUT_MS = 3000;
+        static constexpr int TIMEOUT_CHECK_MS = 250;
+        static constexpr size_t MAX_IN_FLIGHT = 8;  //further requests wait for a response
+        static constexpr int RECONNECT_MIN_MS = 250;    //backoff after the immediate first retry, doubled per failure
+        static constexpr int RECONNECT_MAX_MS = 5000;
+
+        struct Response {
+            bool isOk = false;      //false on a failed request status, a timeout or a disconnect
+            bool isTimeout = false;
+            int code = 0;           //RequestStatus code, 0 if no response came
+            QString comment;        //why OBS failed the request
+            QJsonObject data;       //responseData, or the whole batch response with its results
+            qint64 latencyUs = 0;   //from sending to the response
+        };
+        using ResponseHandler = std::function<void(const Response&)>;
+
+        // The handler is called once, with the response of this very request
+        void sendRequest(const char* requestType, QJsonObject&& requestData = QJsonObject(),
+                ResponseHandler&& onResponse = ResponseHandler());
+
+        void switchToScene(uint16_t sceneId, uint_fast8_t camId);
         void switchStudioMode();
 
-        uint_fast8_t getPrevSceneId(uint_fast8_t sceneId) const;
-        uint_fast8_t getNextSceneId(uint_fast8_t sceneId) const;
+        // Nearest scene below or above sceneId, 0 if there is none
+        uint16_t getPrevSceneId(uint16_t sceneId) const;
+        uint16_t getNextSceneId(uint16_t sceneId) const;
+
+        // Several requests in one message (RequestBatch), e.g.
+        //   obsConnect->batch().add("SetCurrentPreviewScene", {...}).add("TriggerStudioModeTransition").send();
+        // SERIAL_FRAME runs them in the graphics thread, all in the same frame unless a sleep
+        // is added, so a compound switch shows no intermediate state on air.
+        class Batch {
+            public:
+                enum class Execution { SERIAL_REALTIME = 0, SERIAL_FRAME = 1 };  //RequestBatchExecutionType
+
+                Batch& add(const char* requestType, QJsonObject&& requestData = QJsonObject());
+                Batch& sleep(int n);    //frames with SERIAL_FRAME, milliseconds with SERIAL_REALTIME
+                Batch& haltOnFailure();
+                void send(ResponseHandler&& onResponse = ResponseHandler());
+
+            private:
+                friend class OBSConnect;
+                Batch(OBSConnect& connection, Execution exec) : obs(connection), execution(exec) {}
+
+                OBSConnect& obs;
+                const Execution execution;
+                QJsonArray requests;
+                bool isHaltOnFailure = false;
+        };
+        Batch batch(Batch::Execution execution = Batch::Execution::SERIAL_FRAME);
 
     public slots:
-        void addSceneOverrides(const std::unordered_map<uint_fast8_t, uint_fast8_t>& overrides);
+        void addSceneOverrides(const std::unordered_map<uint16_t, uint16_t>& overrides);
         void clearSceneOverrides();
 
     signals:
         void updateStatus(const QString& msg);
-        void currentSceneChanged(uint_fast8_t sceneId, uint_fast8_t camId);
+        void currentSceneChanged(uint16_t sceneId, uint_fast8_t camId);
         void studioModeChanged(bool en);
 
     private:
         void connectOBS();
 
-        void sendRequest(const char* requestType, QJsonObject&& requestData = QJsonObject());
         void sendRequest(const int op, QJsonObject&& d);
+        void sendTracked(const int op, QJsonObject&& d, ResponseHandler&& onResponse);
+        void sendWaiting();
+        void complete(int id, Response&& response);
+        void checkTimeouts();
+        void failAll();
 
+        void processResponse(const QJsonObject& d);
         void processSceneList(QJsonArray&&);
         void createScene(QString&& sceneName);
         void removeScene(const QString& sceneName);
-        std::pair<uint_fast8_t, uint_fast8_t> getSceneIdFromName(const QString& sceneName);
+        bool insertScene(QString&& sceneName);
+        bool eraseScene(const QString& sceneName);
+        void setCurrentScene(std::pair<uint16_t, uint_fast8_t> sceneId);
+        void setStudioMode(bool en);
+        void updateNeighbours();
+        bool isScenePresent(uint16_t sceneId) const { return scenePresent[sceneId / 64] >> (sceneId % 64) & 1; }
+        const QString* findScene(uint16_t sceneId, uint_fast8_t camId) const;
+        std::pair<uint16_t, uint_fast8_t> getSceneIdFromName(const QString& sceneName) const;
+        static std::pair<uint16_t, uint_fast8_t> parseSceneName(const QString& sceneName);
+
+        //Events acted on, and the subscription that delivers each of them
+        struct EventHandler {
+            const char* eventType;
+            unsigned subscription;  //EventSubscription bit
+            void (OBSConnect::*handle)(const QJsonObject& eventData);
+        };
+        static const EventHandler EVENT_HANDLERS[];
+        static unsigned eventSubscriptions();
+        static const EventHandler* findEventHandler(const QStringRef& eventType);
+        static int scanOp(const QString& msg);
+        static QStringRef scanEventType(const QString& msg);
+
+        void onCurrentSceneChanged(const QJsonObject& eventData);
+        void onStudioModeStateChanged(const QJsonObject& eventData);
+        void onSceneCreated(const QJsonObject& eventData);
+        void onSceneRemoved(const QJsonObject& eventData);
+        void onSceneNameChanged(const QJsonObject& eventData);
 
     private slots:
         void processOBSMsg(const QString& msg);
 
     private:
         const OBSSettings& settings;
-
-        std::map<uint_fast8_t, std::map<uint_fast8_t, QString>> sceneMap; //sceneId->camId->sceneName
+        int requestId = 0;
+
+        //Requests sent and not yet answered, by requestId
+        struct InFlight {
+            ResponseHandler onResponse;
+            QElapsedTimer sentAt;
+        };
+        struct Waiting {
+            int op;
+            QJsonObject d;
+            ResponseHandler onResponse;
+        };
+        std::unordered_map<int, InFlight> inFlight;
+        std::deque<Waiting> waiting;
+        QTimer* timeoutTimer;
+
+        //Scene index, rebuilt from the scene list and kept up to date by the scene events
+        struct SceneKey {
+            uint16_t sceneId;
+            uint_fast8_t camId;
+        };
+        std::vector<QString> sceneTable;        //[sceneId * camSlots + camId] -> sceneName, empty if there is none
+        size_t sceneRows = 0;
+        size_t camSlots = 1;
+        std::vector<uint64_t> scenePresent;     //bit per sceneId with a scene of any camId
+        std::vector<uint16_t> prevScene;        //[sceneId] -> nearest scene below, up to sceneRows
+        std::vector<uint16_t> nextScene;        //[sceneId] -> nearest scene above
+        QHash<QString, SceneKey> sceneIds;      //sceneName -> ids, so events need no parsing; also ignored duplicates
+
+        //Last state reported to the GUI, a resync after reconnecting only reports what differs
+        std::pair<uint16_t, uint_fast8_t> currentScene;
+        bool hasCurrentScene = false;
         bool isStudioMode = false;
+        bool hasStudioMode = false;
+
+        QTimer* reconnectTimer;
+        int reconnectCount = 0;     //attempts since OBS last identified us
 
-        std::unordered_map<uint_fast8_t, uint_fast8_t> sceneIdOverride; //sceneId->overrided sceneId
+        std::unordered_map<uint16_t, uint16_t> sceneIdOverride; //sceneId->overrided sceneId
 };
 
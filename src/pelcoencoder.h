@@ -0,0 +1,142 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "cameracommand.h"
+#include "viscaencoder.h"
+
+// Pelco-D and Pelco-P framing. Both carry the same two command bytes and two data
+// bytes, they differ in the frame around them and in a few command bits.
+struct PelcoD {
+    static constexpr size_t FRAME_SIZE = 7;
+    //Command bytes as (cmd1 << 8) | cmd2
+    static constexpr uint16_t FOCUS_FAR  = 0x0080;
+    static constexpr uint16_t FOCUS_NEAR = 0x0100;
+    static constexpr uint16_t IRIS_OPEN  = 0x0200;
+    static constexpr uint16_t IRIS_CLOSE = 0x0400;
+    static constexpr uint16_t CAMERA_ON  = 0x8800;
+    static constexpr uint16_t CAMERA_OFF = 0x0800;
+
+    static size_t frame(uint8_t address, uint16_t cmd, uint8_t data1, uint8_t data2, uint8_t* buf) {
+        buf[0] = 0xff;
+        buf[1] = address;
+        buf[2] = cmd >> 8;
+        buf[3] = cmd & 0xff;
+        buf[4] = data1;
+        buf[5] = data2;
+        buf[6] = static_cast<uint8_t>(buf[1] + buf[2] + buf[3] + buf[4] + buf[5]);
+        return FRAME_SIZE;
+    }
+};
+
+struct PelcoP {
+    static constexpr size_t FRAME_SIZE = 8;
+    static constexpr uint16_t FOCUS_FAR  = 0x0100;
+    static constexpr uint16_t FOCUS_NEAR = 0x0200;
+    static constexpr uint16_t IRIS_OPEN  = 0x0400;
+    static constexpr uint16_t IRIS_CLOSE = 0x0800;
+    static constexpr uint16_t CAMERA_ON  = 0x5000;
+    static constexpr uint16_t CAMERA_OFF = 0x1000;
+
+    static size_t frame(uint8_t address, uint16_t cmd, uint8_t data1, uint8_t data2, uint8_t* buf) {
+        buf[0] = 0xa0;
+        buf[1] = address;
+        buf[2] = cmd >> 8;
+        buf[3] = cmd & 0xff;
+        buf[4] = data1;
+        buf[5] = data2;
+        buf[6] = 0xaf;
+        buf[7] = buf[0] ^ buf[1] ^ buf[2] ^ buf[3] ^ buf[4] ^ buf[5] ^ buf[6];
+        return FRAME_SIZE;
+    }
+};
+
+// A Pelco frame holds the complete motion state of the camera, so stopping zoom
+// must not stop a running pan: the encoder keeps that state per camera and every
+// frame carries all movements still running.
+struct PelcoState {
+    uint16_t motion = 0;    //pan, tilt, zoom and focus command bits
+    uint8_t panSpeed = 0;
+    uint8_t tiltSpeed = 0;
+};
+
+// Pelco encoder for one framing, chosen at compile time
+template <typename Variant>
+struct PelcoEncoder {
+    static constexpr size_t MAX_FRAME_SIZE = Variant::FRAME_SIZE;
+
+    // Encodes cmd into buf, which must hold MAX_FRAME_SIZE bytes.
+    // Returns the frame length, or 0 if the command has no Pelco equivalent or its parameter is invalid.
+    static size_t encode(PelcoState& state, const ViscaEncoder::Limits& limits, uint8_t address,
+            const CameraCommand& cmd, uint8_t* buf) {
+        using Type = CameraCommand::Type;
+        switch (cmd.type) {
+            case Type::MOVE:
+                state.motion &= ~PAN_TILT;
+                state.motion |= cmd.arg1 > 0? RIGHT : cmd.arg1 < 0? LEFT : 0;
+                state.motion |= cmd.arg2 > 0? DOWN : cmd.arg2 < 0? UP : 0;
+                state.panSpeed = clamp(cmd.arg1 < 0? -cmd.arg1 : cmd.arg1, limits.MIN_PAN_SPEED, limits.MAX_PAN_SPEED);
+                state.tiltSpeed = clamp(cmd.arg2 < 0? -cmd.arg2 : cmd.arg2, limits.MIN_TILT_SPEED, limits.MAX_TILT_SPEED);
+                break;
+            case Type::STOP:        state.motion &= ~PAN_TILT; break;
+            case Type::ZOOM_IN:     state.motion = (state.motion & ~ZOOM) | TELE; break;
+            case Type::ZOOM_OUT:    state.motion = (state.motion & ~ZOOM) | WIDE; break;
+            case Type::ZOOM_STOP:   state.motion &= ~ZOOM; break;
+            case Type::FOCUS_FAR:   state.motion = (state.motion & ~FOCUS) | Variant::FOCUS_FAR; break;
+            case Type::FOCUS_NEAR:  state.motion = (state.motion & ~FOCUS) | Variant::FOCUS_NEAR; break;
+            case Type::FOCUS_STOP:  state.motion &= ~FOCUS; break;
+
+            //Extended commands, the opcode is in cmd2
+            case Type::AUTO_FOCUS:   return Variant::frame(address, 0x002b, 0, 0, buf);
+            case Type::MANUAL_FOCUS: return Variant::frame(address, 0x002b, 0, 1, buf);
+            case Type::SET_PRESET:
+            case Type::CALL_PRESET:
+                if (cmd.arg1 <= 0 || cmd.arg1 > 0xff || unsigned(cmd.arg1) < limits.MIN_PRESET_NO ||
+                        unsigned(cmd.arg1) > limits.MAX_PRESET_NO) return 0;
+                return Variant::frame(address, cmd.type == Type::SET_PRESET? 0x0003 : 0x0007, 0, cmd.arg1, buf);
+
+            case Type::POWER_ON:    return Variant::frame(address, Variant::CAMERA_ON, 0, 0, buf);
+            case Type::POWER_OFF:   return Variant::frame(address, Variant::CAMERA_OFF, 0, 0, buf);
+
+            //The on screen menu is opened with preset 95, the stick moves through it, iris open selects
+            case Type::MENU:        return Variant::frame(address, 0x0007, 0, 95, buf);
+            case Type::MENU_UP:     return Variant::frame(address, UP, 0, MENU_SPEED, buf);
+            case Type::MENU_DOWN:   return Variant::frame(address, DOWN, 0, MENU_SPEED, buf);
+            case Type::MENU_LEFT:   return Variant::frame(address, LEFT, MENU_SPEED, 0, buf);
+            case Type::MENU_RIGHT:  return Variant::frame(address, RIGHT, MENU_SPEED, 0, buf);
+            case Type::MENU_ENTER:  return Variant::frame(address, Variant::IRIS_OPEN, 0, 0, buf);
+            case Type::MENU_BACK:   return Variant::frame(address, Variant::IRIS_CLOSE, 0, 0, buf);
+
+            default:
+                return 0;
+        }
+        return encodeState(state, address, buf);
+    }
+
+    // The frame of the running movements, also the release of a menu key
+    static size_t encodeState(const PelcoState& state, uint8_t address, uint8_t* buf) {
+        bool isPanning = state.motion & PAN_TILT;
+        return Variant::frame(address, state.motion, isPanning? state.panSpeed : 0, isPanning? state.tiltSpeed : 0, buf);
+    }
+
+    static constexpr bool isKeyPress(CameraCommand::Type t) {
+        return t == CameraCommand::Type::MENU_UP || t == CameraCommand::Type::MENU_DOWN ||
+               t == CameraCommand::Type::MENU_LEFT || t == CameraCommand::Type::MENU_RIGHT ||
+               t == CameraCommand::Type::MENU_ENTER || t == CameraCommand::Type::MENU_BACK;
+    }
+
+    private:
+        enum : uint16_t {
+            RIGHT = 0x02, LEFT = 0x04, UP = 0x08, DOWN = 0x10, TELE = 0x20, WIDE = 0x40,
+            PAN_TILT = RIGHT | LEFT | UP | DOWN,
+            ZOOM = TELE | WIDE,
+            FOCUS = Variant::FOCUS_FAR | Variant::FOCUS_NEAR,
+            MENU_SPEED = 0x20
+        };
+
+        static uint8_t clamp(int v, unsigned lo, unsigned hi) {
+            return static_cast<uint8_t>(v < int(lo)? lo : v > int(hi)? hi : unsigned(v));
+        }
+};
@@ -0,0 +1,95 @@
+// vim:ts=4:sw=4:et:cin
+
+#include "presetstore.h"
+#include <QDebug>
+
+PresetStore::PresetStore(const QString& filename)
+    : file(filename)
+{
+    if (!file.open(QIODevice::ReadWrite)) {
+        qWarning("Cannot open preset file %s: %s", filename.toUtf8().constData(), file.errorString().toUtf8().constData());
+        return;
+    }
+
+    if (file.size() == 0) {
+        if (!mapFile(INITIAL_CAPACITY)) return;
+        header->magic = MAGIC;
+        header->version = VERSION;
+        header->capacity = INITIAL_CAPACITY;
+        header->count = 0;
+        return;
+    }
+
+    if (file.size() < qint64(sizeof(Header))) {
+        qWarning("Preset file %s is truncated, host presets disabled.", filename.toUtf8().constData());
+        return;
+    }
+    Header h;
+    file.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (h.magic != MAGIC || h.version != VERSION || h.count > h.capacity ||
+            file.size() < qint64(sizeof(Header) + h.capacity * sizeof(Record))) {
+        qWarning("Preset file %s is not valid, host presets disabled.", filename.toUtf8().constData());
+        return;
+    }
+    if (!mapFile(h.capacity)) return;
+
+    index.reserve(header->count);
+    for (uint32_t i = 0; i < header->count; i++) {
+        index[key(records[i].cameraId, records[i].presetNo)] = i;
+    }
+}
+
+PresetStore::~PresetStore()
+{
+    if (header) file.unmap(reinterpret_cast<uchar*>(header));
+}
+
+//The old mapping is only dropped once the new one is in place, so a failed resize keeps the presets working
+bool PresetStore::mapFile(uint32_t capacity)
+{
+    qint64 size = sizeof(Header) + qint64(capacity) * sizeof(Record);
+    if (file.size() < size && !file.resize(size)) {
+        qWarning("Cannot resize preset file: %s", file.errorString().toUtf8().constData());
+        return false;
+    }
+    uchar* p = file.map(0, size);
+    if (!p) {
+        qWarning("Cannot map preset file: %s", file.errorString().toUtf8().constData());
+        return false;
+    }
+    if (header) file.unmap(reinterpret_cast<uchar*>(header));
+    header = reinterpret_cast<Header*>(p);
+    records = reinterpret_cast<Record*>(p + sizeof(Header));
+    return true;
+}
+
+bool PresetStore::find(int cameraId, unsigned presetNo, Position& pos) const
+{
+    if (!header) return false;
+    auto it = index.find(key(cameraId, presetNo));
+    if (it == index.end()) return false;
+    pos = records[it->second].pos;
+    return true;
+}
+
+bool PresetStore::store(int cameraId, unsigned presetNo, const Position& pos)
+{
+    if (!header) return false;
+
+    auto it = index.find(key(cameraId, presetNo));
+    if (it != index.end()) {
+        records[it->second].pos = pos;
+        return true;
+    }
+
+    if (header->count == header->capacity) {
+        uint32_t capacity = header->capacity * 2;
+        if (!mapFile(capacity)) return false;
+        header->capacity = capacity;
+    }
+    uint32_t i = header->count;
+    records[i] = Record{cameraId, presetNo, pos, 0};
+    header->count = i + 1; //after the record, so a crash never leaves a garbage record counted
+    index[key(cameraId, presetNo)] = i;
+    return true;
+}
@@ -0,0 +1,53 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <QFile>
+
+// Host side presets, kept in a memory-mapped file of fixed-size records keyed
+// by camera ID and preset no. A preset is the absolute position of the camera,
+// so it does not depend on the preset memory of the camera.
+class PresetStore {
+    public:
+        struct Position {
+            int16_t  pan;
+            int16_t  tilt;
+            uint16_t zoom;
+        };
+
+        explicit PresetStore(const QString& filename);
+        ~PresetStore();
+
+        bool isOpen() const { return header != nullptr; }
+        bool find(int cameraId, unsigned presetNo, Position& pos) const;
+        bool store(int cameraId, unsigned presetNo, const Position& pos);
+
+    private:
+        static constexpr uint32_t MAGIC = 0x50435643; //"CVCP"
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint32_t INITIAL_CAPACITY = 256;
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t capacity;
+            uint32_t count;
+        };
+        struct Record {
+            int32_t  cameraId;
+            uint32_t presetNo;
+            Position pos;
+            uint16_t reserved;
+        };
+        static_assert(sizeof(Header) == 16 && sizeof(Record) == 16, "file layout must not depend on padding");
+
+        static uint64_t key(int cameraId, unsigned presetNo) { return (uint64_t(uint32_t(cameraId)) << 32) | presetNo; }
+        bool mapFile(uint32_t capacity);
+
+        QFile file;
+        Header* header = nullptr;
+        Record* records = nullptr;
+        std::unordered_map<uint64_t, uint32_t> index; //key -> record
+};
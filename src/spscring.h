@@ -0,0 +1,42 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// T is copied in and out, so it should be a small trivially copyable type.
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of 2");
+    public:
+        static constexpr size_t CAPACITY = N;
+
+        // Producer side, false if the ring is full
+        bool push(const T& v) {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == N) return false;
+            buf[t & (N - 1)] = v;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side, false if the ring is empty
+        bool pop(T& v) {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) return false;
+            v = buf[h & (N - 1)];
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        //Head and tail on their own cache lines, so the two threads do not share one
+        static constexpr size_t CACHE_LINE = 64;
+        std::atomic<size_t> head{0};
+        char headPad[CACHE_LINE - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> tail{0};
+        char tailPad[CACHE_LINE - sizeof(std::atomic<size_t>)];
+        T buf[N];
+};
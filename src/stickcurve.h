@@ -0,0 +1,41 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Response curve from a stick or trigger deflection to a camera speed, tabulated
+// once so the control loop only quantises the deflection and looks it up.
+class StickCurve {
+    public:
+        static constexpr size_t STEPS = 256;
+        static constexpr uint8_t STOP = 0xff;
+
+        // Deflections up to deadzone stop the camera. Beyond it the deflection is rescaled
+        // to 0..1 and shaped by y = (1-expo)*x + expo*x^3, which leaves more of the
+        // stick travel to low speeds as expo grows.
+        void build(double deadzone, double expo, unsigned minSpeed, unsigned maxSpeed) {
+            for (size_t i = 0; i < STEPS; i++) {
+                double x = double(i) / (STEPS-1);
+                if (i == 0 || x <= deadzone) {
+                    lut[i] = STOP;
+                    continue;
+                }
+                x = (x - deadzone) / (1 - deadzone);
+                double y = (1 - expo) * x + expo * x * x * x;
+                unsigned speed = minSpeed + static_cast<unsigned>(y * (maxSpeed - minSpeed + 1));
+                lut[i] = static_cast<uint8_t>(speed > maxSpeed? maxSpeed : speed);
+            }
+        }
+
+        // Speed for the deflection v in -1..1, STOP inside the deadzone
+        uint8_t lookup(double v) const {
+            if (v < 0) v = -v;
+            if (v > 1) v = 1;
+            return lut[static_cast<size_t>(v * (STEPS-1) + 0.5)];
+        }
+
+    private:
+        uint8_t lut[STEPS] = {STOP};
+};
@@ -463,7 +463,7 @@ void StreamDeckConnect::presetNextPage()
     updatePresetKeys();
 }
 
-void StreamDeckConnect::setCurScene(uint_fast8_t scene, int camId)
+void StreamDeckConnect::setCurScene(uint16_t scene, int camId)
 {
     if (scene != curScene) {
         auto iter = sceneKeyMap.find(curScene);
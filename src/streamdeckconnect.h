@@ -30,7 +30,7 @@ class StreamDeckConnect : public QWebSocket {
 
     signals:
         void updateStatus(const QString& msg);
-        void sceneChanged(uint_fast8_t scene, uint_fast8_t camIndex);
+        void sceneChanged(uint16_t scene, uint_fast8_t camIndex);
         void switchScene();
         void switchStudioMode();
         void selectCam(int camIndex);
@@ -76,7 +76,7 @@ class StreamDeckConnect : public QWebSocket {
         void matrixGetMapping();
 
     public slots:
-        void setCurScene(uint_fast8_t scene, int camId);
+        void setCurScene(uint16_t scene, int camId);
         void setCamIndex(int cam);
         void setStudioMode(bool en);
         void matrixUpdateMapping(const std::unordered_map<unsigned, std::vector<unsigned>>& mapping);
@@ -118,10 +118,10 @@ class StreamDeckConnect : public QWebSocket {
         static constexpr size_t NUM_COLUMN = 8;
         StreamDeckKey* key[NUM_PAGE][NUM_ROW][NUM_COLUMN] = {};
 
-        uint_fast8_t curScene = 0;
+        uint16_t curScene = 0;
         int curCamIndex = 0; //Active Cam
         int camIndex = 0;    //Preview Cam
-        std::map<uint_fast8_t, StreamDeckKey_Scene*> sceneKeyMap; //scene->key
+        std::map<uint16_t, StreamDeckKey_Scene*> sceneKeyMap; //scene->key
         std::vector<StreamDeckKey_Tally*> cameraKeyMap; //camIndex->key
         StreamDeckKey_Tally* switchCamKey1 = nullptr;
         StreamDeckKey_Tally* switchCamKey2 = nullptr;
@@ -77,7 +77,7 @@ StreamDeckKey_Scene::StreamDeckKey_Scene(
         StreamDeckConnect* owner,
         const QString& deckId_, int page_, int row_, int column_,
         QImage&& iconOff, QImage&& iconOn,
-        uint_fast8_t sceneId)
+        uint16_t sceneId)
     : StreamDeckKey_Switch(owner, deckId_, page_, row_, column_, std::move(iconOff), std::move(iconOn)), scene(sceneId)
 {
 }
@@ -167,13 +167,13 @@ class StreamDeckKey_TriState_LongPress : public StreamDeckKey_TriState {
 class StreamDeckKey_Scene : public StreamDeckKey_Switch {
     Q_OBJECT
     public:
-        StreamDeckKey_Scene(StreamDeckConnect* owner, const QString& deckId_, int page_, int row_, int column_, QImage&& iconOff, QImage&& iconOn, uint_fast8_t sceneId);
+        StreamDeckKey_Scene(StreamDeckConnect* owner, const QString& deckId_, int page_, int row_, int column_, QImage&& iconOff, QImage&& iconOn, uint16_t sceneId);
         virtual ~StreamDeckKey_Scene() {}
 
-        uint_fast8_t getSceneId() { return scene; }
+        uint16_t getSceneId() { return scene; }
 
     private:
-        uint_fast8_t scene;
+        uint16_t scene;
 };
 
 class StreamDeckKey_Tally : public StreamDeckKey {
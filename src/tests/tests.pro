@@ -0,0 +1,15 @@
+QT       += testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_cameracommandqueue
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    tst_cameracommandqueue.cpp
+
+HEADERS += \
+    ../cameracommand.h
@@ -0,0 +1,99 @@
+// vim:ts=4:sw=4:et:cin
+
+#include <QtTest>
+
+#include "cameracommand.h"
+
+class TestCameraCommandQueue : public QObject
+{
+    Q_OBJECT
+
+    private:
+        typedef CameraCommandQueue<8> Queue;
+        static bool isOnlyPending(Queue& queue, CameraCommand::Type t) {
+            CameraCommand cmd;
+            return queue.pop(cmd) && cmd.type == t && !queue.pop(cmd);
+        }
+
+    private slots:
+        void stopJumpsAhead();
+        void coalescesClass();
+        void cancelsPresetRecall_data();
+        void cancelsPresetRecall();
+        void keepsPresetRecall();
+        void skipsUnchangedState();
+};
+
+void TestCameraCommandQueue::stopJumpsAhead()
+{
+    Queue queue;
+    queue.push(CameraCommand::make(CameraCommand::Type::MENU));
+    queue.push(CameraCommand::make(CameraCommand::Type::ZOOM_STOP));
+    CameraCommand cmd;
+    QVERIFY(queue.pop(cmd));
+    QCOMPARE(int(cmd.type), int(CameraCommand::Type::ZOOM_STOP));
+    QVERIFY(queue.pop(cmd));
+    QCOMPARE(int(cmd.type), int(CameraCommand::Type::MENU));
+    QVERIFY(queue.empty());
+}
+
+void TestCameraCommandQueue::coalescesClass()
+{
+    Queue queue;
+    queue.push(CameraCommand::make(CameraCommand::Type::MOVE, 1, 0));
+    queue.push(CameraCommand::make(CameraCommand::Type::MOVE, 5, -3));
+    CameraCommand cmd;
+    QVERIFY(queue.pop(cmd));
+    QVERIFY(cmd == CameraCommand::make(CameraCommand::Type::MOVE, 5, -3));
+    QVERIFY(!queue.pop(cmd));
+}
+
+void TestCameraCommandQueue::cancelsPresetRecall_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::newRow("STOP") << int(CameraCommand::Type::STOP);
+    QTest::newRow("MOVE") << int(CameraCommand::Type::MOVE);
+    QTest::newRow("ABSOLUTE_PAN_TILT") << int(CameraCommand::Type::ABSOLUTE_PAN_TILT);
+    QTest::newRow("ZOOM_DIRECT") << int(CameraCommand::Type::ZOOM_DIRECT);
+}
+
+void TestCameraCommandQueue::cancelsPresetRecall()
+{
+    QFETCH(int, type);
+    CameraCommand::Type t = static_cast<CameraCommand::Type>(type);
+    Queue queue;
+    queue.push(CameraCommand::make(CameraCommand::Type::CALL_PRESET, 3));
+    QVERIFY(queue.isPending(CameraCommand::Class::CALL_PRESET));
+    queue.push(CameraCommand::make(t, 1, 1, 1));
+    QVERIFY(!queue.isPending(CameraCommand::Class::CALL_PRESET));
+    QVERIFY(isOnlyPending(queue, t));
+}
+
+void TestCameraCommandQueue::keepsPresetRecall()
+{
+    Queue queue;
+    queue.push(CameraCommand::make(CameraCommand::Type::CALL_PRESET, 3));
+    queue.push(CameraCommand::make(CameraCommand::Type::FOCUS_STOP));
+    QVERIFY(queue.isPending(CameraCommand::Class::CALL_PRESET));
+    CameraCommand cmd;
+    QVERIFY(queue.pop(cmd));
+    QCOMPARE(int(cmd.type), int(CameraCommand::Type::FOCUS_STOP));
+    QVERIFY(isOnlyPending(queue, CameraCommand::Type::CALL_PRESET));
+}
+
+void TestCameraCommandQueue::skipsUnchangedState()
+{
+    Queue queue;
+    CameraCommand move = CameraCommand::make(CameraCommand::Type::MOVE, 3, 0);
+    CameraCommand target = CameraCommand::make(CameraCommand::Type::ABSOLUTE_PAN_TILT, 100, -20, 5);
+    queue.markSent(move);
+    QVERIFY(queue.isUnchanged(move));
+    queue.markSent(target);
+    QVERIFY(!queue.isUnchanged(target));
+    queue.markSent(CameraCommand::make(CameraCommand::Type::ZOOM_DIRECT, 0x4000));
+    QVERIFY(!queue.isUnchanged(CameraCommand::make(CameraCommand::Type::ZOOM_DIRECT, 0x4000)));
+}
+
+QTEST_APPLESS_MAIN(TestCameraCommandQueue)
+
+#include "tst_cameracommandqueue.moc"
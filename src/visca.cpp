@@ -1,543 +1,727 @@
 // vim:ts=4:sw=4:et:cin
 
 #include "visca.h"
-#include <stdio.h>
-#include <string>
-#include <vector>
-#include <QUdpSocket>
+#include <algorithm>
+#include <QAbstractSocket>
 #include <QHostAddress>
+#include <QHostInfo>
+#include <QTimer>
 #include <QString>
 #include <QDebug>
 #include "cvcsetting.h"
+#include "viscatransport.h"
+#include "viscaserialline.h"
 
-CameraConnect::CameraConnect(const CameraSettings& cameraSettings, QObject* parent)
-    : QUdpSocket(parent), settings(cameraSettings), seqNo(0)
+constexpr ViscaEncoder::Template ViscaEncoder::STRICT_TABLE[];
+constexpr ViscaEncoder::Template ViscaEncoder::LOOSE_TABLE[];
+constexpr CameraCommand::Type CameraConnect::INQUIRIES[];
+
+//Inquiry replies carry each value as 4 nibbles 0p 0q 0r 0s
+static uint16_t fromNibbles(const uint8_t* p)
+{
+    return ((p[0] & 0x0f) << 12) | ((p[1] & 0x0f) << 8) | ((p[2] & 0x0f) << 4) | (p[3] & 0x0f);
+}
+
+CameraConnect::CameraConnect(const CameraSettings& cameraSettings, ViscaTransport* viscaTransport,
+        ViscaSerialLine* line, QObject* parent)
+    : QObject(parent), settings(cameraSettings), transport(viscaTransport), serialLine(line),
+      peerId(line? 0 : viscaTransport->addCamera(this)),
+      //Serial cameras are Sony style, like the strict IP ones
+      encoderTable(cameraSettings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_LOOSE?
+              ViscaEncoder::LOOSE_TABLE : ViscaEncoder::STRICT_TABLE),
+      encoderLimits{
+          cameraSettings.MIN_PAN_SPEED, cameraSettings.MAX_PAN_SPEED,
+          cameraSettings.MIN_TILT_SPEED, cameraSettings.MAX_TILT_SPEED,
+          cameraSettings.MIN_ZOOM_SPEED, cameraSettings.MAX_ZOOM_SPEED,
+          cameraSettings.MIN_FOCUS_SPEED, cameraSettings.MAX_FOCUS_SPEED,
+          cameraSettings.MIN_PRESET_NO, cameraSettings.MAX_PRESET_NO},
+      seqNo(0)
+{
+    udpTimeout = new QTimer(this);
+    udpTimeout->setSingleShot(true);
+    connect(udpTimeout, &QTimer::timeout, this, &CameraConnect::onCommandTimeout);
+
+    inquiryTimer = new QTimer(this);
+    inquiryTimer->setSingleShot(true);
+    connect(inquiryTimer, &QTimer::timeout, this, &CameraConnect::startInquiryRound);
+
+    if (serialLine) {
+        if (!settings.isPelco()) serialLine->addCamera(this, settings.VISCA_ADDRESS); //Pelco replies are not routed
+        connect(serialLine, &ViscaSerialLine::opened, this, &CameraConnect::onLineOpened);
+        connect(serialLine, &ViscaSerialLine::closed, this, &CameraConnect::onLineClosed);
+    }
+
+    //Queued, so the lookup and the first packets belong to the thread the camera runs in
+    QMetaObject::invokeMethod(this, "resolvePeer", Qt::QueuedConnection);
+}
+
+void CameraConnect::resolvePeer()
 {
+    if (serialLine) {
+        if (serialLine->isOpen() && !hasPeer) onLineOpened();
+        return;
+    }
+    if (lookupId >= 0) return;
+    QHostAddress address;
+    if (address.setAddress(settings.CAMERA_HOST)) {
+        connectToPeer(address);
+    } else {
+        lookupId = QHostInfo::lookupHost(settings.CAMERA_HOST, this, &CameraConnect::onPeerResolved);
+    }
+}
+
+void CameraConnect::onPeerResolved(const QHostInfo& info)
+{
+    lookupId = -1;
+    const QList<QHostAddress> addresses = info.addresses();
+    if (info.error() != QHostInfo::NoError || addresses.isEmpty()) {
+        qWarning("Cannot resolve camera %d host %s: %s", settings.CAMERA_ID,
+                settings.CAMERA_HOST.toUtf8().constData(), info.errorString().toUtf8().constData());
+        QTimer::singleShot(RESOLVE_RETRY_MS, this, &CameraConnect::resolvePeer);
+        return;
+    }
+    QHostAddress address = addresses.first();
+    for (const QHostAddress& a : addresses) {
+        if (a.protocol() == QAbstractSocket::IPv4Protocol) {
+            address = a;
+            break;
+        }
+    }
+    connectToPeer(address);
+}
+
+void CameraConnect::connectToPeer(const QHostAddress& address)
+{
+    //Replies from this address and port are routed to this camera by the transport
+    peerAddress = address;
+    transport->setPeer(peerId, peerAddress, settings.CAMERA_PORT);
+    hasPeer = true;
     resetSeqNo();
+
+    //Send what was queued while the address was unknown, then learn the camera state
+    inquiryMask = 0;
+    isInquiryRound = false;
+    startInquiryRound();
 }
 
-void CameraConnect::resetSeqNo()
+void CameraConnect::onLineOpened()
 {
-    if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string reset_cmd(9, '\0');
-        reset_cmd[0] = 0x02;
-        reset_cmd[1] = 0x00;
-        reset_cmd[2] = 0x00;
-        reset_cmd[3] = 0x01;
-        reset_cmd[4] = 0x00;
-        reset_cmd[5] = 0x00;
-        reset_cmd[6] = 0x00;
-        reset_cmd[7] = 0x00;
-        reset_cmd[8] = 0x01;
-        if (QUdpSocket::writeDatagram(reset_cmd.c_str(), reset_cmd.size(), QHostAddress(settings.CAMERA_HOST), settings.CAMERA_PORT) < 0) {
-            qWarning("UDP Send Error: %s", QUdpSocket::errorString().toUtf8().constData());
-            return;
+    //The line numbered the chain anew, the cameras may have been power cycled meanwhile
+    hasPeer = true;
+    cmdQueue.invalidateAll();
+    inquiryMask = 0;
+    isInquiryRound = false;
+    startInquiryRound();
+}
+
+void CameraConnect::onLineClosed()
+{
+    //Commands wait in the queue, a command in flight times out
+    hasPeer = false;
+}
+
+void CameraConnect::addCommand(const CameraCommand& cmd)
+{
+    unsigned classBit = 1u << static_cast<unsigned>(cmd.cmdClass());
+    if (CameraCommand::isMotion(cmd.type)) {
+        movingMask |= classBit;
+        motionIntent.start();
+    } else {
+        movingMask &= ~classBit;
+    }
+
+    //Menu keys pressed during warm-up would surprise the operator once the camera is up
+    if (power == PowerState::BOOTING && cmd.cmdClass() == CameraCommand::Class::NONE) {
+        emit commandFinished(cmd, CommandResult::ERROR);
+        return;
+    }
+    if (!cmdQueue.push(cmd)) {
+        qWarning("Command queue of camera %d is full, command dropped.", settings.CAMERA_ID);
+        return;
+    }
+    //The camera is being controlled, poll it closely again
+    if (inquiryIntervalMs > INQUIRY_MIN_MS) {
+        inquiryIntervalMs = INQUIRY_MIN_MS;
+        if (!isInquiryRound) inquiryTimer->start(inquiryIntervalMs);
+    }
+    if (isIdle) {
+        isIdle = false;
+        execNextCommand();
+    } else if (CameraCommand::priorityOf(cmd.type) == CameraCommand::Priority::STOP) {
+        preemptInFlight();
+    }
+}
+
+void CameraConnect::preemptInFlight()
+{
+    if (!isAwaitingReply || isResyncing) return;
+    if (CameraCommand::isInquiry(inFlight.type)) {
+        //Only with sequence numbers, a late reply could not be told apart from the stop's ACK otherwise
+        if (settings.CAMERA_PROTOCAL != CameraSettings::Protocal::VISCA_STRICT) return;
+        //The stop goes out now, the inquiry is asked again later in the round
+        for (size_t i = 0; i < NUM_INQUIRIES; i++) {
+            if (INQUIRIES[i] == inFlight.type) inquiryMask |= 1u << i;
         }
-        seqNo = 0;
+    } else if (ackedSockets) {
+        //The camera took the command, the stop must not wait for its Completion
+        ackedSockets = 0;
+        emit commandFinished(inFlight, CommandResult::DONE);
+    } else {
+        return;
     }
+    isAwaitingReply = false;
+    execNextCommand();
+}
+
+void CameraConnect::refreshMotionIntent()
+{
+    if (movingMask) motionIntent.start();
+}
+
+void CameraConnect::checkMotionWatchdog(int windowMs)
+{
+    if (!movingMask || !motionIntent.hasExpired(windowMs)) return;
+    qWarning("No control input for moving camera %d in %d ms, stopping it.", settings.CAMERA_ID, windowMs);
+    unsigned mask = movingMask;
+    if (mask & (1u << static_cast<unsigned>(CameraCommand::Class::PAN_TILT)))
+        addCommand(CameraCommand::make(CameraCommand::Type::STOP));
+    if (mask & (1u << static_cast<unsigned>(CameraCommand::Class::ZOOM)))
+        addCommand(CameraCommand::make(CameraCommand::Type::ZOOM_STOP));
+    if (mask & (1u << static_cast<unsigned>(CameraCommand::Class::FOCUS)))
+        addCommand(CameraCommand::make(CameraCommand::Type::FOCUS_STOP));
+}
+
+int CameraConnect::cameraId() const
+{
+    return settings.CAMERA_ID;
+}
+
+void CameraConnect::clearCommandQueue()
+{
+    cmdQueue.clear();
+    udpTimeout->stop();
+    isAwaitingReply = false;
+    ackedSockets = 0;   //their Completions are dropped
+    isIdle = true;
+    inquiryMask = 0;
+    if (isInquiryRound) finishInquiryRound();
 }
 
-void CameraConnect::voiSend (const std::string& visca_cmd)
+void CameraConnect::execNextCommand()
 {
-    // Read Previous data
-    while (QUdpSocket::hasPendingDatagrams()) {
-        auto n = QUdpSocket::pendingDatagramSize();
-        std::vector<char> c(n);
-        if (QUdpSocket::readDatagram (c.data(), n) >= 0) {
-        } else {
-            qWarning("UDP Read Error: %s", QUdpSocket::errorString().toUtf8().constData());
+    udpTimeout->stop();
+    //The reply or timeout of the last inquiry ends the round
+    if (isInquiryRound && inquiryMask == 0 && CameraCommand::isInquiry(inFlight.type)) finishInquiryRound();
+
+    CameraCommand cmd;
+    while (isPeerConnected() && popNextCommand(cmd)) {
+        if (cmdQueue.isUnchanged(cmd)) {
+            emit commandFinished(cmd, CommandResult::DONE);
+            continue;
+        }
+        if (sendCommand(cmd)) {
+            cmdQueue.markSent(cmd);
+            if (cmd.cmdClass() == CameraCommand::Class::POWER) onPowerCommand(cmd.type);
+            if (settings.isPelco()) {
+                //Nothing to wait for, the line paces the frames
+                emit commandFinished(cmd, CommandResult::DONE);
+                continue;
+            }
+            inFlight = cmd;
+            retransmitCount = 0;
+            rttTimer.start();
+            udpTimeout->start(rtoMs);
             return;
         }
+        emit commandFinished(cmd, CommandResult::ERROR);
     }
+    //Inquiries only use the time no command is waiting
+    if (sendNextInquiry()) return;
+    isIdle = true;
+}
 
-    // Send this data
-    const std::string* to_send = nullptr;
-    std::string visca_with_header(8+visca_cmd.size(), '\0');
-    if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        seqNo++;
-        visca_with_header[0] = 0x01;
-        visca_with_header[1] = 0x00;
-        visca_with_header[2] = (char) (visca_cmd.size() >> 8) & 0xff;
-        visca_with_header[3] = (char) (visca_cmd.size()     ) & 0xff;
-        visca_with_header[4] = (char) (seqNo >> 24) & 0xff;
-        visca_with_header[5] = (char) (seqNo >> 16) & 0xff;
-        visca_with_header[6] = (char) (seqNo >>  8) & 0xff;
-        visca_with_header[7] = (char) (seqNo      ) & 0xff;
-        for (size_t i = 0; i < visca_cmd.size(); i++)
-            visca_with_header[8+i] = visca_cmd[i];
-        to_send = &visca_with_header;
+bool CameraConnect::popNextCommand(CameraCommand& cmd)
+{
+    //A booting camera drops what it is sent, only power commands get through
+    if (power == PowerState::BOOTING) return cmdQueue.popClass(CameraCommand::Class::POWER, cmd);
+    return cmdQueue.pop(cmd);
+}
+
+void CameraConnect::setPowerState(PowerState state)
+{
+    if (state == power) return;
+    power = state;
+    emit powerStateChanged(state);
+}
+
+void CameraConnect::onPowerCommand(CameraCommand::Type type)
+{
+    //Pelco cameras cannot be asked, so they are never held
+    if (type == CameraCommand::Type::POWER_OFF || settings.isPelco()) {
+        isPowerOnSent = false;
+        setPowerState(PowerState::STANDBY);
+        return;
+    }
+    if (power == PowerState::READY) return;
+    //Commands are only held once the camera reports standby after this, see POWER_INQ
+    isPowerOnSent = true;
+    bootTimer.start();
+    if (!isInquiryRound) inquiryTimer->start(BOOT_POLL_MS);
+}
+
+void CameraConnect::startInquiryRound()
+{
+    if (power == PowerState::BOOTING && bootTimer.hasExpired(BOOT_TIMEOUT_MS)) {
+        qWarning("Camera %d did not report ready in %d ms, sending its held commands.", settings.CAMERA_ID,
+                BOOT_TIMEOUT_MS);
+        isPowerOnSent = false;
+        setPowerState(PowerState::UNKNOWN);
+    }
+    if (isInquiryRound || !isPeerConnected()) return; //connectToPeer starts a round
+    isInquiryRound = true;
+    isStateChanged = false;
+    inquiryMask = power == PowerState::BOOTING? POWER_INQUIRY_BIT : (1u << NUM_INQUIRIES) - 1;
+    if (isIdle) {
+        isIdle = false;
+        execNextCommand();
+    }
+}
+
+bool CameraConnect::sendNextInquiry()
+{
+    if (settings.isPelco()) inquiryMask = 0; //no inquiries, the round ends right away
+    while (isPeerConnected() && inquiryMask) {
+        size_t i = 0;
+        while (!(inquiryMask & (1u << i))) i++;
+        inquiryMask &= ~(1u << i);
+
+        CameraCommand cmd = CameraCommand::make(INQUIRIES[i]);
+        if (sendCommand(cmd)) {
+            inFlight = cmd;
+            retransmitCount = 0;
+            rttTimer.start();
+            udpTimeout->start(rtoMs);
+            return true;
+        }
+    }
+    if (isInquiryRound && inquiryMask == 0) finishInquiryRound();
+    return false;
+}
+
+void CameraConnect::refreshState()
+{
+    inquiryTimer->stop();
+    inquiryIntervalMs = INQUIRY_MIN_MS;
+    if (isInquiryRound) {
+        //Values of this round may predate the request
+        inquiryMask = power == PowerState::BOOTING? POWER_INQUIRY_BIT : (1u << NUM_INQUIRIES) - 1;
     } else {
-        to_send = &visca_cmd;
+        startInquiryRound();
     }
-    if (QUdpSocket::writeDatagram(to_send->c_str(), to_send->size(), QHostAddress(settings.CAMERA_HOST), settings.CAMERA_PORT) < 0) {
-        qWarning("UDP Send Error: %s", QUdpSocket::errorString().toUtf8().constData());
+}
+
+void CameraConnect::finishInquiryRound()
+{
+    isInquiryRound = false;
+    emit stateRefreshed(camState);
+    if (power == PowerState::BOOTING) {
+        //Also for cameras that never replied, the boot timeout releases their commands
+        inquiryTimer->start(BOOT_POLL_MS);
         return;
     }
+    //A camera that never replies would only have its commands delayed by polling
+    if (srttUs < 0) return;
+    //Poll fast while something changes, back off while the camera sits still
+    inquiryIntervalMs = isStateChanged? INQUIRY_MIN_MS : std::min(inquiryIntervalMs * 2, INQUIRY_MAX_MS);
+    inquiryTimer->start(inquiryIntervalMs);
 }
 
-void CameraConnect::viscaMove (int x, int y)
-{
-    char cX = (x>0? 0x02 : x<0? 0x01 : 0x03);
-    char cY = (y>0? 0x02 : y<0? 0x01 : 0x03);
-    if (x < 0) x = -x;
-    if (y < 0) y = -y;
-    if (x < settings.MIN_PAN_SPEED) x = settings.MIN_PAN_SPEED;
-    if (x > settings.MAX_PAN_SPEED) x = settings.MAX_PAN_SPEED;
-    if (y < settings.MIN_TILT_SPEED) y = settings.MIN_TILT_SPEED;
-    if (y > settings.MAX_TILT_SPEED) y = settings.MAX_TILT_SPEED;
-    std::string cmd (9, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x06;
-    cmd [3] = 0x01;
-    cmd [4] = (char) x;
-    cmd [5] = (char) y;
-    cmd [6] = cX;
-    cmd [7] = cY;
-    cmd [8] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaLeft (unsigned value)
-{
-    if (value < settings.MIN_PAN_SPEED) value = settings.MIN_PAN_SPEED;
-    if (value > settings.MAX_PAN_SPEED) value = settings.MAX_PAN_SPEED;
-    std::string cmd (9, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x06;
-    cmd [3] = 0x01;
-    cmd [4] = (char) value;
-    cmd [5] = 0x01;
-    cmd [6] = 0x01;
-    cmd [7] = 0x03;
-    cmd [8] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaRight (unsigned value)
-{
-    if (value < settings.MIN_PAN_SPEED) value = settings.MIN_PAN_SPEED;
-    if (value > settings.MAX_PAN_SPEED) value = settings.MAX_PAN_SPEED;
-    std::string cmd (9, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x06;
-    cmd [3] = 0x01;
-    cmd [4] = (char) value;
-    cmd [5] = 0x01;
-    cmd [6] = 0x02;
-    cmd [7] = 0x03;
-    cmd [8] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaUp (unsigned value)
-{
-    if (value < settings.MIN_TILT_SPEED) value = settings.MIN_TILT_SPEED;
-    if (value > settings.MAX_TILT_SPEED) value = settings.MAX_TILT_SPEED;
-    std::string cmd (9, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x06;
-    cmd [3] = 0x01;
-    cmd [4] = 0x01;
-    cmd [5] = (char) value;
-    cmd [6] = 0x03;
-    cmd [7] = 0x01;
-    cmd [8] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaDown (unsigned value)
-{
-    if (value < settings.MIN_TILT_SPEED) value = settings.MIN_TILT_SPEED;
-    if (value > settings.MAX_TILT_SPEED) value = settings.MAX_TILT_SPEED;
-    std::string cmd (9, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x06;
-    cmd [3] = 0x01;
-    cmd [4] = 0x01;
-    cmd [5] = (char) value;
-    cmd [6] = 0x03;
-    cmd [7] = 0x02;
-    cmd [8] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaStop ()
-{
-    std::string cmd (9, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x06;
-    cmd [3] = 0x01;
-    cmd [4] = 0x01;
-    cmd [5] = 0x01;
-    cmd [6] = 0x03;
-    cmd [7] = 0x03;
-    cmd [8] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaIn (unsigned value)
-{
-    if (value < settings.MIN_ZOOM_SPEED) value = settings.MIN_ZOOM_SPEED;
-    if (value > settings.MAX_ZOOM_SPEED) value = settings.MAX_ZOOM_SPEED;
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x07;
-    cmd [4] = 0x20 | value;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaOut (unsigned value)
-{
-    if (value < settings.MIN_ZOOM_SPEED) value = settings.MIN_ZOOM_SPEED;
-    if (value > settings.MAX_ZOOM_SPEED) value = settings.MAX_ZOOM_SPEED;
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x07;
-    cmd [4] = 0x30 | value;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaZoomStop ()
-{
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x07;
-    cmd [4] = 0x00;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaFar (unsigned value)
-{
-    if (value < settings.MIN_FOCUS_SPEED) value = settings.MIN_FOCUS_SPEED;
-    if (value > settings.MAX_FOCUS_SPEED) value = settings.MAX_FOCUS_SPEED;
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x08;
-    cmd [4] = 0x20 | value;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaNear (unsigned value)
-{
-    if (value < settings.MIN_FOCUS_SPEED) value = settings.MIN_FOCUS_SPEED;
-    if (value > settings.MAX_FOCUS_SPEED) value = settings.MAX_FOCUS_SPEED;
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x08;
-    cmd [4] = 0x30 | value;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaFocusStop ()
-{
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x08;
-    cmd [4] = 0x00;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaAutoFocus ()
-{
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x38;
-    cmd [4] = 0x02;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaManualFocus ()
-{
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x38;
-    cmd [4] = 0x03;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaFocusAM ()
-{
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x38;
-    cmd [4] = 0x10;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaSet (unsigned value)
-{
-    if (value < settings.MIN_PRESET_NO) { perror ("Wrong Preset No."); return; }
-    if (value > settings.MAX_PRESET_NO) { perror ("Wrong Preset No."); return; }
-    std::string cmd (7, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x3f;
-    cmd [4] = 0x01;
-    cmd [5] = value;
-    cmd [6] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaGo (unsigned value)
-{
-    if (value < settings.MIN_PRESET_NO) { perror ("Wrong Preset No."); return; }
-    if (value > settings.MAX_PRESET_NO) { perror ("Wrong Preset No."); return; }
-    std::string cmd (7, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x3f;
-    cmd [4] = 0x02;
-    cmd [5] = value;
-    cmd [6] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaOn ()
-{
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x00;
-    cmd [4] = 0x02;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
-
-void CameraConnect::viscaOff ()
-{
-    std::string cmd (6, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x04;
-    cmd [3] = 0x00;
-    cmd [4] = 0x03;
-    cmd [5] = 0xff;
-    voiSend (cmd);
-}
+bool CameraConnect::sendCommand(const CameraCommand& cmd)
+{
+    switch (settings.CAMERA_PROTOCAL) {
+        case CameraSettings::Protocal::PELCO_D: return sendPelco<PelcoD>(cmd);
+        case CameraSettings::Protocal::PELCO_P: return sendPelco<PelcoP>(cmd);
+        default: break;
+    }
 
-void CameraConnect::viscaMenu ()
+    uint8_t* payload = txBuf + ViscaEncoder::HEADER_SIZE;
+    size_t len = ViscaEncoder::encode(encoderTable, encoderLimits, cmd, payload);
+    if (len == 0) {
+        qWarning("Invalid parameter %d for camera %d command.", cmd.arg1, settings.CAMERA_ID);
+        return false;
+    }
+    if (serialLine) payload[0] = 0x80 | settings.VISCA_ADDRESS;
+    bool isUrgent = CameraCommand::priorityOf(cmd.type) == CameraCommand::Priority::STOP;
+    if (!voiSend(payload, len, isUrgent)) return false;
+    ackedSockets = 0;
+    awaitedReplies = 1;
+
+    //Key press style commands need a release
+    uint8_t releaseIdx = encoderTable[static_cast<size_t>(cmd.type)].releaseIdx;
+    if (releaseIdx) {
+        payload[releaseIdx] = 0x00;
+        if (voiSend(payload, len)) awaitedReplies = 2;
+    }
+    return true;
+}
+
+template <typename Variant>
+bool CameraConnect::sendPelco(const CameraCommand& cmd)
 {
-    if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string cmd (6, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x06;
-        cmd [3] = 0x06;
-        cmd [4] = 0x10;
-        cmd [5] = 0xff;
-        voiSend (cmd);
-    } else {
-        std::string cmd (7, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x04;
-        cmd [3] = 0x3f;
-        cmd [4] = 0x02;
-        cmd [5] = 0x5f;
-        cmd [6] = 0xff;
-        voiSend (cmd);
+    uint8_t frame[PelcoEncoder<Variant>::MAX_FRAME_SIZE];
+    uint8_t address = static_cast<uint8_t>(settings.PELCO_ADDRESS);
+    size_t len = PelcoEncoder<Variant>::encode(pelcoState, encoderLimits, address, cmd, frame);
+    if (len == 0) {
+        qWarning("Command %d with parameter %d is not available on Pelco camera %d.", int(cmd.type), cmd.arg1,
+                settings.CAMERA_ID);
+        return false;
     }
+    bool isStop = CameraCommand::priorityOf(cmd.type) == CameraCommand::Priority::STOP;
+    if (!transmit(frame, len, isStop)) return false;
+    //Pelco cameras do not acknowledge, so a stop goes out twice to survive one lost frame
+    if (isStop) transmit(frame, len, true);
+    if (PelcoEncoder<Variant>::isKeyPress(cmd.type)) {
+        len = PelcoEncoder<Variant>::encodeState(pelcoState, address, frame);
+        transmit(frame, len, false);
+    }
+    return true;
 }
 
-void CameraConnect::viscaMenuUp ()
+bool CameraConnect::sendBroadcast(const CameraCommand& cmd)
 {
-    if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string cmd (9, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x7e;
-        cmd [3] = 0x04;
-        cmd [4] = 0x40;
-        cmd [5] = 0x03;
-        cmd [6] = 0x01;
-        cmd [7] = 0x01;
-        cmd [8] = 0xff;
-        voiSend (cmd);
-        cmd [7] = 0x00;
-        voiSend (cmd);
-    } else {
-        viscaUp(0x0E);
+    if (!serialLine || settings.isPelco()) return false;
+    uint8_t frame[ViscaEncoder::MAX_PACKET_SIZE];
+    size_t len = ViscaEncoder::encode(encoderTable, encoderLimits, cmd, frame);
+    if (len == 0) return false;
+    frame[0] = 0x80 | ViscaSerialLine::BROADCAST;
+    return serialLine->send(frame, len, true);
+}
+
+void CameraConnect::onBroadcast(const CameraCommand& cmd, bool isSent)
+{
+    if (isSent) {
+        //Supersedes anything of its class still waiting
+        cmdQueue.cancel(cmd.cmdClass());
+        cmdQueue.markSent(cmd);
+        movingMask &= ~(1u << static_cast<unsigned>(cmd.cmdClass()));
+        if (cmd.cmdClass() == CameraCommand::Class::POWER) onPowerCommand(cmd.type);
     }
+    emit commandFinished(cmd, isSent? CommandResult::DONE : CommandResult::ERROR);
 }
 
-void CameraConnect::viscaMenuDown ()
+bool CameraConnect::transmit(const uint8_t* data, size_t len, bool isUrgent)
 {
-    if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string cmd (9, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x7e;
-        cmd [3] = 0x04;
-        cmd [4] = 0x40;
-        cmd [5] = 0x03;
-        cmd [6] = 0x02;
-        cmd [7] = 0x01;
-        cmd [8] = 0xff;
-        voiSend (cmd);
-        cmd [7] = 0x00;
-        voiSend (cmd);
-    } else {
-        viscaDown(0x0E);
+    if (serialLine) return serialLine->send(data, len, isUrgent);
+    return transport->send(peerId, data, len);
+}
+
+void CameraConnect::onCommandTimeout()
+{
+    if (isResyncing) {
+        if (++resetRetryCount < MAX_RESET_RETRY) {
+            resetSeqNo();
+            udpTimeout->start(rtoMs);
+            return;
+        }
+        //Give up waiting for the RESET ACK, the numbering restarted anyway
+        isResyncing = false;
+        if (replayAfterReset && !CameraCommand::isInquiry(inFlight.type)) emit commandFinished(inFlight, CommandResult::TIMEOUT);
+        replayAfterReset = false;
+        cmdQueue.invalidateAll();
+        if (!isIdle) execNextCommand();
+        return;
+    }
+
+    if (ackedSockets) {
+        //The camera took the command, only its Completion is late or lost
+        isAwaitingReply = false;
+        ackedSockets = 0;
+        emit commandFinished(inFlight, CommandResult::DONE);
+        execNextCommand();
+        return;
+    }
+
+    //Cameras that never reply keep the fixed timeout and only get stops retransmitted.
+    //A stop must reach the camera, unless a newer command of its class is already waiting.
+    bool isStop = CameraCommand::priorityOf(inFlight.type) == CameraCommand::Priority::STOP;
+    if (srttUs >= 0 || isStop) {
+        if (srttUs >= 0) rtoMs = std::min(rtoMs * 2, UDP_TIMEOUT_MS);
+        int maxRetransmit = isStop? MAX_STOP_RETRANSMIT : MAX_RETRANSMIT;
+        bool isSuperseded = isStop && cmdQueue.isPending(inFlight.cmdClass());
+        if (retransmitCount < maxRetransmit && !isSuperseded && CameraCommand::isIdempotent(inFlight.type) && isPeerConnected()) {
+            //Same bytes and sequence number, so a late ACK of the first copy still matches
+            if (transmit(txDatagram, txLen, isStop)) {
+                retransmitCount++;
+                udpTimeout->start(rtoMs);
+                return;
+            }
+        }
+    }
+
+    //No reply in time, so a late reply must not release the next command
+    isAwaitingReply = false;
+    if (power == PowerState::BOOTING && inFlight.type == CameraCommand::Type::POWER_INQ) {
+        //Holding commands for a camera that does not answer would only delay them
+        isPowerOnSent = false;
+        setPowerState(PowerState::UNKNOWN);
     }
+    cmdQueue.invalidate(inFlight.cmdClass());
+    if (!CameraCommand::isInquiry(inFlight.type)) emit commandFinished(inFlight, CommandResult::TIMEOUT);
+    execNextCommand();
 }
 
-void CameraConnect::viscaMenuLeft ()
+void CameraConnect::updateRto(qint64 rttUs)
 {
-    if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string cmd (9, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x7e;
-        cmd [3] = 0x04;
-        cmd [4] = 0x40;
-        cmd [5] = 0x01;
-        cmd [6] = 0x03;
-        cmd [7] = 0x01;
-        cmd [8] = 0xff;
-        voiSend (cmd);
-        cmd [7] = 0x00;
-        voiSend (cmd);
+    if (srttUs < 0) {
+        srttUs = rttUs;
+        rttvarUs = rttUs / 2;
+        //First reply, the camera can be polled
+        if (!isInquiryRound && !inquiryTimer->isActive()) inquiryTimer->start(INQUIRY_MIN_MS);
     } else {
-        viscaLeft(0x0E);
+        qint64 err = srttUs - rttUs;
+        rttvarUs += ((err < 0? -err : err) - rttvarUs) / 4;
+        srttUs += (rttUs - srttUs) / 8;
     }
+    qint64 rtoUs = srttUs + std::max<qint64>(1000, 4 * rttvarUs);
+    rtoMs = static_cast<int>(std::min<qint64>(std::max<qint64>(rtoUs / 1000, MIN_RTO_MS), UDP_TIMEOUT_MS));
 }
 
-void CameraConnect::viscaMenuRight ()
+void CameraConnect::resetSeqNo()
 {
     if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string cmd (9, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x7e;
-        cmd [3] = 0x04;
-        cmd [4] = 0x40;
-        cmd [5] = 0x02;
-        cmd [6] = 0x03;
-        cmd [7] = 0x01;
-        cmd [8] = 0xff;
-        voiSend (cmd);
-        cmd [7] = 0x00;
-        voiSend (cmd);
-    } else {
-        viscaRight(0x0E);
+        //Own buffer, txBuf may hold a command to be replayed after the reset
+        uint8_t ctrl[ViscaEncoder::HEADER_SIZE + 1];
+        ViscaEncoder::encodeHeader(ctrl, 0x0200, 1, 0); //Control command
+        ctrl[ViscaEncoder::HEADER_SIZE] = 0x01;         //RESET
+        if (!transport->send(peerId, ctrl, sizeof(ctrl))) return;
+        seqNo = 0;
     }
 }
 
-void CameraConnect::viscaMenuEnter ()
+//payload must point to txBuf + HEADER_SIZE, so the header is written in front of it
+bool CameraConnect::voiSend (const uint8_t* payload, size_t len, bool isUrgent)
 {
+    const uint8_t* datagram = payload;
     if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string cmd (9, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x7e;
-        cmd [3] = 0x04;
-        cmd [4] = 0x40;
-        cmd [5] = 0x07;
-        cmd [6] = 0x00;
-        cmd [7] = 0x01;
-        cmd [8] = 0xff;
-        voiSend (cmd);
-        cmd [7] = 0x00;
-        voiSend (cmd);
-    } else {
-        std::string cmd (6, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x06;
-        cmd [3] = 0x06;
-        cmd [4] = 0x05;
-        cmd [5] = 0xff;
-        voiSend (cmd);
+        seqNo++;
+        ViscaEncoder::encodeHeader(txBuf, ViscaEncoder::payloadTypeOf(payload), len, seqNo); //VISCA command or inquiry
+        datagram = txBuf;
+        len += ViscaEncoder::HEADER_SIZE;
     }
+    txDatagram = datagram;
+    txLen = len;
+    if (!transmit(datagram, len, isUrgent)) return false;
+    isAwaitingReply = true;
+    return true;
+}
+
+void CameraConnect::onSendError()
+{
+    if (!hasPeer) return;
+    qWarning("Sending to camera %d failed.", settings.CAMERA_ID);
+    //The address may be stale, resolve it again before the next command
+    hasPeer = false;
+    transport->clearPeer(peerId);
+    QTimer::singleShot(RESOLVE_RETRY_MS, this, &CameraConnect::resolvePeer);
 }
 
-void CameraConnect::viscaMenuBack ()
+void CameraConnect::processDatagram(const char* reply, size_t n)
 {
+    if (settings.isPelco()) return; //no replies expected
     if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
-        std::string cmd (9, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x7e;
-        cmd [3] = 0x04;
-        cmd [4] = 0x40;
-        cmd [5] = 0x07;
-        cmd [6] = 0x01;
-        cmd [7] = 0x01;
-        cmd [8] = 0xff;
-        voiSend (cmd);
-        cmd [7] = 0x00;
-        voiSend (cmd);
+        if (n < 8) return;
+        const uint8_t* h = reinterpret_cast<const uint8_t*>(reply);
+        uint16_t payloadType = (h[0] << 8) | h[1];
+        size_t payloadLen = (h[2] << 8) | h[3];
+        uint32_t replySeqNo = (uint32_t(h[4]) << 24) | (h[5] << 16) | (h[6] << 8) | h[7];
+        if (payloadLen > size_t(n) - 8) payloadLen = n - 8;
+        if (payloadType == 0x0111) {        //VISCA reply
+            processViscaReply(reply + 8, payloadLen, replySeqNo);
+        } else if (payloadType == 0x0201) { //Control reply
+            processControlReply(reinterpret_cast<const uint8_t*>(reply) + 8, payloadLen);
+        }
     } else {
-        std::string cmd (6, '\0');
-        cmd [0] = 0x81;
-        cmd [1] = 0x01;
-        cmd [2] = 0x06;
-        cmd [3] = 0x06;
-        cmd [4] = 0x04;
-        cmd [5] = 0xff;
-        voiSend (cmd);
+        //No header, replies can only be matched to the last command sent
+        processViscaReply(reply, n, seqNo);
     }
 }
 
-void CameraConnect::viscaAutoFramingStart ()
+void CameraConnect::processControlReply(const uint8_t* reply, size_t len)
 {
-    std::string cmd (7, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x7e;
-    cmd [3] = 0x04;
-    cmd [4] = 0x3a;
-    cmd [5] = 0x01;
-    cmd [6] = 0xff;
-    voiSend (cmd);
+    if (len >= 2 && reply[0] == 0x0f) {
+        //0x0f 0x01: sequence number error, 0x0f 0x02: message error, e.g. the camera was rebooted
+        qWarning("VISCA sequence error 0x%02x from camera %d, resetting.", reply[1], settings.CAMERA_ID);
+        if (!isResyncing) {
+            isResyncing = true;
+            resetRetryCount = 0;
+            replayAfterReset = isAwaitingReply;
+            isAwaitingReply = false;
+            resetSeqNo();
+            udpTimeout->start(rtoMs);
+        }
+    } else if (len >= 1 && reply[0] == 0x01) {
+        //RESET acknowledged
+        if (!isResyncing) return;
+        isResyncing = false;
+        udpTimeout->stop();
+        cmdQueue.invalidateAll(); //a rebooted camera forgot its state
+
+        if (replayAfterReset && settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
+            //The command rejected with the sequence error is sent again with a new number
+            ViscaEncoder::encodeHeader(txBuf, ViscaEncoder::payloadTypeOf(txBuf + ViscaEncoder::HEADER_SIZE),
+                    txLen - ViscaEncoder::HEADER_SIZE, ++seqNo);
+            if (transport->send(peerId, txBuf, txLen)) {
+                isAwaitingReply = true;
+                retransmitCount = 1; //no RTT sample
+                udpTimeout->start(rtoMs);
+                return;
+            }
+            if (!CameraCommand::isInquiry(inFlight.type)) emit commandFinished(inFlight, CommandResult::ERROR);
+        }
+        if (!isIdle) execNextCommand();
+    }
 }
 
-void CameraConnect::viscaAutoFramingStop ()
+void CameraConnect::processViscaReply(const char* reply, size_t len, uint32_t replySeqNo)
 {
-    std::string cmd (7, '\0');
-    cmd [0] = 0x81;
-    cmd [1] = 0x01;
-    cmd [2] = 0x7e;
-    cmd [3] = 0x04;
-    cmd [4] = 0x3a;
-    cmd [5] = 0x00;
-    cmd [6] = 0xff;
-    voiSend (cmd);
+    if (len < 3) return;
+    const uint8_t* r = reinterpret_cast<const uint8_t*>(reply);
+    if ((r[0] & 0x8f) != 0x80) return; //not a reply from a camera
+
+    switch (r[1] & 0xf0) {
+        case 0x40: //ACK
+        case 0x50: //Completion
+            break;
+
+        case 0x60: //Error
+            {
+                uint8_t errorCode = (len >= 4)? r[2] : 0;
+                const char* errorStr =
+                    errorCode == 0x01? "Message length error" :
+                    errorCode == 0x02? "Syntax error" :
+                    errorCode == 0x03? "Command buffer full" :
+                    errorCode == 0x04? "Command canceled" :
+                    errorCode == 0x05? "No socket" :
+                    errorCode == 0x41? "Command not executable" : "Unknown error";
+                qWarning("VISCA Error from camera %d: %s (0x%02x)", settings.CAMERA_ID, errorStr, errorCode);
+                break;
+            }
+
+        default:
+            return;
+    }
+
+    if (!isAwaitingReply) return;
+    uint8_t kind = r[1] & 0xf0;
+    uint8_t socket = r[1] & 0x0f;
+    if (settings.CAMERA_PROTOCAL == CameraSettings::Protocal::VISCA_STRICT) {
+        //Release on the first reply (normally the ACK) of the command in flight
+        if (replySeqNo != seqNo) return;
+        if (retransmitCount == 0) updateRto(rttTimer.nsecsElapsed() / 1000); //Karn's algorithm
+    } else if (CameraCommand::isInquiry(inFlight.type)) {
+        //Inquiries are answered on socket 0, anything else is late from an earlier command
+        if (kind == 0x40 || socket != 0) return;
+        if (retransmitCount == 0) updateRto(rttTimer.nsecsElapsed() / 1000);
+    } else if (socket != 0) {
+        //Replies are only matched by position, so a command is held until the sockets it was ACKed on complete
+        unsigned socketBit = 1u << socket;
+        if (kind == 0x40) {
+            if (!ackedSockets && retransmitCount == 0) updateRto(rttTimer.nsecsElapsed() / 1000);
+            ackedSockets |= socketBit;
+            udpTimeout->start(COMPLETION_TIMEOUT_MS); //executing, nothing to retransmit
+            return;
+        }
+        if (!(ackedSockets & socketBit)) return; //of a command given up on
+        ackedSockets &= ~socketBit;
+        if (kind == 0x50 && --awaitedReplies > 0) return;
+    } else if (kind != 0x60) {
+        return; //an inquiry reply while a command is in flight
+    }
+
+    isAwaitingReply = false;
+    ackedSockets = 0;
+    udpTimeout->stop();
+    bool isError = kind == 0x60;
+    if (isError) cmdQueue.invalidate(inFlight.cmdClass());
+    bool isPowerInquiry = inFlight.type == CameraCommand::Type::POWER_INQ;
+    if (power == PowerState::BOOTING && (isPowerInquiry? isError : inFlight.cmdClass() != CameraCommand::Class::POWER)) {
+        //The camera cannot tell its power, or already answers other commands
+        isPowerOnSent = false;
+        setPowerState(PowerState::UNKNOWN);
+    }
+    if (CameraCommand::isInquiry(inFlight.type)) {
+        if (r[1] == 0x50) processInquiryReply(r, len);
+    } else {
+        emit commandFinished(inFlight, isError? CommandResult::ERROR : CommandResult::DONE);
+    }
+    if (!isIdle) execNextCommand();
 }
 
+void CameraConnect::processInquiryReply(const uint8_t* r, size_t len)
+{
+    switch (inFlight.type) {
+        case CameraCommand::Type::PAN_TILT_POS_INQ: //y0 50 0w 0w 0w 0w 0z 0z 0z 0z ff
+            {
+                if (len < 11 || r[10] != 0xff) return;
+                int16_t pan = static_cast<int16_t>(fromNibbles(r + 2));
+                int16_t tilt = static_cast<int16_t>(fromNibbles(r + 6));
+                if (camState.hasPanTilt && pan == camState.pan && tilt == camState.tilt) return;
+                camState.hasPanTilt = true;
+                camState.pan = pan;
+                camState.tilt = tilt;
+                isStateChanged = true;
+                emit panTiltPositionChanged(pan, tilt);
+                break;
+            }
+
+        case CameraCommand::Type::ZOOM_POS_INQ: //y0 50 0p 0q 0r 0s ff
+            {
+                if (len < 7 || r[6] != 0xff) return;
+                uint16_t zoom = fromNibbles(r + 2);
+                if (camState.hasZoom && zoom == camState.zoom) return;
+                camState.hasZoom = true;
+                camState.zoom = zoom;
+                isStateChanged = true;
+                emit zoomPositionChanged(zoom);
+                break;
+            }
+
+        case CameraCommand::Type::FOCUS_MODE_INQ: //y0 50 02 ff auto, y0 50 03 ff manual
+            {
+                if (len < 4 || r[3] != 0xff || (r[2] != 0x02 && r[2] != 0x03)) return;
+                bool isManual = (r[2] == 0x03);
+                //The mode may have been switched from the remote or the menu, so the queue compares with the real one
+                cmdQueue.markSent(CameraCommand::make(isManual? CameraCommand::Type::MANUAL_FOCUS : CameraCommand::Type::AUTO_FOCUS));
+                CameraState::FocusMode mode = isManual? CameraState::FocusMode::MANUAL : CameraState::FocusMode::AUTO;
+                if (mode == camState.focusMode) return;
+                camState.focusMode = mode;
+                isStateChanged = true;
+                emit focusModeChanged(isManual);
+                break;
+            }
+
+        case CameraCommand::Type::POWER_INQ: //y0 50 02 ff on, y0 50 03 ff standby
+            {
+                if (len < 4 || r[3] != 0xff || (r[2] != 0x02 && r[2] != 0x03)) return;
+                bool isOn = (r[2] == 0x02);
+                //Held commands go out right after this reply. A booting camera may still report standby for a moment.
+                if (isOn) {
+                    isPowerOnSent = false;
+                    setPowerState(PowerState::READY);
+                } else if (isPowerOnSent && !bootTimer.hasExpired(BOOT_TIMEOUT_MS)) {
+                    setPowerState(PowerState::BOOTING);
+                } else if (power != PowerState::BOOTING) {
+                    setPowerState(PowerState::STANDBY);
+                }
+                CameraState::Power reported = isOn? CameraState::Power::ON : CameraState::Power::STANDBY;
+                if (reported == camState.power) return;
+                camState.power = reported;
+                isStateChanged = true;
+                emit powerChanged(isOn);
+                break;
+            }
+
+        default:
+            break;
+    }
+}
@@ -2,52 +2,198 @@
 
 #pragma once
 
-#include <string>
-#include <QUdpSocket>
+#include <QObject>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include "cameracommand.h"
+#include "viscaencoder.h"
+#include "pelcoencoder.h"
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+class QHostInfo;
+QT_END_NAMESPACE
 
 class CameraSettings;
+class ViscaTransport;
+class ViscaSerialLine;
+
+enum class CommandResult : uint8_t {
+    DONE,       //acknowledged, or skipped because the camera already has that state
+    ERROR,      //error reply or not sent
+    TIMEOUT
+};
+
+// Power lifecycle as the pipeline tracks it. While BOOTING, commands are held in
+// the queue, where commands of a class coalesce, and go out once the camera
+// reports that it is on.
+enum class PowerState : uint8_t {
+    UNKNOWN,
+    STANDBY,
+    BOOTING,    //powered on, not yet reporting on
+    READY
+};
+
+// What the camera reported in its last inquiry replies
+struct CameraState {
+    enum class FocusMode : uint8_t { UNKNOWN, AUTO, MANUAL };
+    enum class Power : uint8_t { UNKNOWN, ON, STANDBY };
 
-class CameraConnect : public QUdpSocket {
+    bool hasPanTilt = false;
+    int16_t pan = 0;
+    int16_t tilt = 0;
+    bool hasZoom = false;
+    uint16_t zoom = 0;
+    FocusMode focusMode = FocusMode::UNKNOWN;
+    Power power = Power::UNKNOWN;
+};
+
+class CameraConnect : public QObject {
     Q_OBJECT
     public:
-        CameraConnect(const CameraSettings&, QObject *parent = nullptr);
+        // Serial cameras use serialLine, all others the shared UDP transport
+        CameraConnect(const CameraSettings&, ViscaTransport*, ViscaSerialLine* serialLine, QObject *parent = nullptr);
         virtual ~CameraConnect() {}
 
+        static constexpr int UDP_TIMEOUT_MS = 500;  //initial and maximum retransmission timeout
+        static constexpr int MIN_RTO_MS = 50;
+        static constexpr int MAX_RETRANSMIT = 1;
+        static constexpr int COMPLETION_TIMEOUT_MS = 1000;  //ACKed command, without sequence numbers
+        static constexpr int MAX_STOP_RETRANSMIT = 3;   //stops are sent until acknowledged, up to this many times more
+        static constexpr int MAX_RESET_RETRY = 3;
+        static constexpr int RESOLVE_RETRY_MS = 1000;
+        static constexpr int INQUIRY_MIN_MS = 200;      //polling interval while the camera is controlled
+        static constexpr int INQUIRY_MAX_MS = 5000;     //backed off to this while nothing changes
+        static constexpr int BOOT_POLL_MS = 500;        //power inquiry interval while booting
+        static constexpr int BOOT_TIMEOUT_MS = 30000;   //held commands are released after this anyway
+
+        void addCommand(const CameraCommand&);
+        void clearCommandQueue();
+        int cameraId() const;
+
         void resetSeqNo();
 
-        void viscaMove (int x, int y);
-        void viscaLeft (unsigned value);
-        void viscaRight (unsigned value);
-        void viscaUp (unsigned value);
-        void viscaDown (unsigned value);
-        void viscaStop ();
-        void viscaIn (unsigned value);
-        void viscaOut (unsigned value);
-        void viscaZoomStop ();
-        void viscaFar (unsigned value);
-        void viscaNear (unsigned value);
-        void viscaFocusStop ();
-        void viscaAutoFocus ();
-        void viscaManualFocus ();
-        void viscaFocusAM ();
-        void viscaSet (unsigned value);
-        void viscaGo (unsigned value);
-        void viscaOn ();
-        void viscaOff ();
-        void viscaMenu ();
-        void viscaMenuUp ();
-        void viscaMenuDown ();
-        void viscaMenuLeft ();
-        void viscaMenuRight ();
-        void viscaMenuEnter ();
-        void viscaMenuBack ();
-        void viscaAutoFramingStart ();
-        void viscaAutoFramingStop ();
+        int retransmitTimeout() const { return rtoMs; }
+        const CameraState& cameraState() const { return camState; }     //other threads get it from stateRefreshed()
+        PowerState powerState() const { return power; }
+        void refreshState(); //inquire now, stateRefreshed() follows
+
+        // Motion dead-man watchdog: a moving camera whose intent is not refreshed within the window is stopped
+        void refreshMotionIntent();
+        void checkMotionWatchdog(int windowMs);
+
+        //Called by the transport or the serial line
+        void processDatagram(const char* data, size_t len);
+        void onSendError();
+
+        // A frame to every camera on the serial line, which do not reply to it.
+        // onBroadcast() tells each of them that it was sent.
+        bool sendBroadcast(const CameraCommand&);
+        void onBroadcast(const CameraCommand&, bool isSent);
+
+    signals:
+        void panTiltPositionChanged(int pan, int tilt);
+        void zoomPositionChanged(int zoom);
+        void focusModeChanged(bool isManual);
+        void powerChanged(bool isOn);
+        void powerStateChanged(PowerState state);
+        void stateRefreshed(const CameraState& state);
+        void commandFinished(const CameraCommand& cmd, CommandResult result);
+
+    private slots:
+        void resolvePeer();
+        void onPeerResolved(const QHostInfo&);
+        void execNextCommand();
+        void onCommandTimeout();
+        void startInquiryRound();
+        void onLineOpened();
+        void onLineClosed();
 
     private:
         const CameraSettings& settings;
-        void voiSend(const std::string& visca_cmd);
+        ViscaTransport* const transport;
+        ViscaSerialLine* const serialLine;
+        const unsigned peerId;
+        bool transmit(const uint8_t* data, size_t len, bool isUrgent);
+        void connectToPeer(const QHostAddress&);
+        bool isPeerConnected() const { return hasPeer; }
 
+        bool sendCommand(const CameraCommand&);
+        template <typename Variant> bool sendPelco(const CameraCommand&);
+        bool voiSend(const uint8_t* payload, size_t len, bool isUrgent = false);
+        void updateRto(qint64 rttUs);
+        void processViscaReply(const char* reply, size_t len, uint32_t replySeqNo);
+        void processControlReply(const uint8_t* reply, size_t len);
+        void processInquiryReply(const uint8_t* reply, size_t len);
+        bool sendNextInquiry();
+        void preemptInFlight();
+        void finishInquiryRound();
+        bool popNextCommand(CameraCommand& cmd);
+        void setPowerState(PowerState state);
+        void onPowerCommand(CameraCommand::Type type);
+
+        const ViscaEncoder::Template* const encoderTable;
+        const ViscaEncoder::Limits encoderLimits;
+        PelcoState pelcoState;  //Pelco frames repeat every movement still running
+        uint8_t txBuf[ViscaEncoder::HEADER_SIZE + ViscaEncoder::MAX_PACKET_SIZE];
+        const uint8_t* txDatagram = txBuf;  //last datagram sent, kept for retransmission
+        size_t txLen = 0;
         uint32_t seqNo;
+        bool isAwaitingReply = false;
+
+        //Sequence number resynchronisation after a sequence error
+        bool isResyncing = false;
+        bool replayAfterReset = false;
+        int resetRetryCount = 0;
+
+        //Camera address, resolved once and kept until sending fails
+        QHostAddress peerAddress;
+        bool hasPeer = false;
+        int lookupId = -1;
+
+        //Command pipeline, stops jump ahead of everything queued
+        static constexpr size_t CMD_QUEUE_SIZE = 32;    //per priority
+        QTimer* udpTimeout;
+        CameraCommandQueue<CMD_QUEUE_SIZE> cmdQueue;
+        bool isIdle = true;
+        CameraCommand inFlight = {};
+
+        //Round trip time estimation (RFC 6298) from the ACK of each command
+        QElapsedTimer rttTimer;
+        qint64 srttUs = -1;     //-1 until the camera has replied once
+        qint64 rttvarUs = 0;
+        int rtoMs = UDP_TIMEOUT_MS;
+        int retransmitCount = 0;
+
+        //Without sequence numbers a command is done on the Completion of each socket it was ACKed on
+        unsigned ackedSockets = 0;
+        uint8_t awaitedReplies = 0;     //2 when a release packet follows the command
+
+        //Classes with a continuous movement running, and when it was last asked for
+        unsigned movingMask = 0;
+        QElapsedTimer motionIntent;
+
+        //Inquiries fill the time the pipeline is idle, one round of each type per interval
+        static constexpr CameraCommand::Type INQUIRIES[] = {
+            CameraCommand::Type::POWER_INQ, CameraCommand::Type::FOCUS_MODE_INQ,
+            CameraCommand::Type::ZOOM_POS_INQ, CameraCommand::Type::PAN_TILT_POS_INQ};
+        static constexpr size_t NUM_INQUIRIES = sizeof(INQUIRIES) / sizeof(INQUIRIES[0]);
+        QTimer* inquiryTimer;
+        unsigned inquiryMask = 0;       //inquiries not yet sent in this round
+        bool isInquiryRound = false;
+        bool isStateChanged = false;
+        int inquiryIntervalMs = INQUIRY_MIN_MS;
+        CameraState camState;
+
+        //Only the power is asked while booting, INQUIRIES starts with it
+        enum : unsigned { POWER_INQUIRY_BIT = 1u };
+        PowerState power = PowerState::UNKNOWN;
+        bool isPowerOnSent = false;     //until the camera reports its power, standby then means booting
+        QElapsedTimer bootTimer;
 };
 
+//Signal arguments, for queued connections across the camera I/O thread
+Q_DECLARE_METATYPE(CameraCommand)
+Q_DECLARE_METATYPE(CommandResult)
+Q_DECLARE_METATYPE(CameraState)
+Q_DECLARE_METATYPE(PowerState)
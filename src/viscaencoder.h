@@ -0,0 +1,175 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "cameracommand.h"
+
+// Table driven VISCA encoder. Every CameraCommand::Type has a packet template
+// whose parameter bytes are patched in place, so encoding never allocates.
+struct ViscaEncoder {
+    static constexpr size_t MAX_PACKET_SIZE = 16;
+    static constexpr size_t HEADER_SIZE = 8; //VISCA over IP header
+
+    enum class Param : uint8_t {
+        NONE,
+        PAN_TILT,       //bytes 4,5 = pan/tilt speed, bytes 6,7 = direction
+        SPEED_NIBBLE,   //byte 4 |= speed
+        PRESET,         //byte 5 = preset no.
+        ABS_PAN_TILT,   //bytes 4,5 = pan/tilt speed, bytes 6-9 = pan, bytes 10-13 = tilt nibbles
+        ZOOM_POSITION,  //bytes 4-7 = zoom position nibbles
+        MENU_MOVE       //bytes 4,5 = template speed of the moving axis, clamped like PAN_TILT
+    };
+
+    struct Template {
+        CameraCommand::Type type;
+        Param   param;
+        uint8_t releaseIdx; //if not 0, a second packet with this byte cleared releases the key
+        uint8_t len;
+        uint8_t bytes[MAX_PACKET_SIZE];
+    };
+
+    struct Limits {
+        unsigned MIN_PAN_SPEED, MAX_PAN_SPEED;
+        unsigned MIN_TILT_SPEED, MAX_TILT_SPEED;
+        unsigned MIN_ZOOM_SPEED, MAX_ZOOM_SPEED;
+        unsigned MIN_FOCUS_SPEED, MAX_FOCUS_SPEED;
+        unsigned MIN_PRESET_NO, MAX_PRESET_NO;
+    };
+
+    static constexpr size_t NUM_TYPES = static_cast<size_t>(CameraCommand::Type::POWER_INQ) + 1;
+
+    // Sony style commands, used with the strict VISCA over IP protocol
+    static constexpr Template STRICT_TABLE[NUM_TYPES] = {
+        {CameraCommand::Type::MOVE,               Param::PAN_TILT,     0, 9, {0x81, 0x01, 0x06, 0x01, 0x00, 0x00, 0x03, 0x03, 0xff}},
+        {CameraCommand::Type::STOP,               Param::NONE,         0, 9, {0x81, 0x01, 0x06, 0x01, 0x01, 0x01, 0x03, 0x03, 0xff}},
+        {CameraCommand::Type::ZOOM_IN,            Param::SPEED_NIBBLE, 0, 6, {0x81, 0x01, 0x04, 0x07, 0x20, 0xff}},
+        {CameraCommand::Type::ZOOM_OUT,           Param::SPEED_NIBBLE, 0, 6, {0x81, 0x01, 0x04, 0x07, 0x30, 0xff}},
+        {CameraCommand::Type::ZOOM_STOP,          Param::NONE,         0, 6, {0x81, 0x01, 0x04, 0x07, 0x00, 0xff}},
+        {CameraCommand::Type::FOCUS_FAR,          Param::SPEED_NIBBLE, 0, 6, {0x81, 0x01, 0x04, 0x08, 0x20, 0xff}},
+        {CameraCommand::Type::FOCUS_NEAR,         Param::SPEED_NIBBLE, 0, 6, {0x81, 0x01, 0x04, 0x08, 0x30, 0xff}},
+        {CameraCommand::Type::FOCUS_STOP,         Param::NONE,         0, 6, {0x81, 0x01, 0x04, 0x08, 0x00, 0xff}},
+        {CameraCommand::Type::AUTO_FOCUS,         Param::NONE,         0, 6, {0x81, 0x01, 0x04, 0x38, 0x02, 0xff}},
+        {CameraCommand::Type::MANUAL_FOCUS,       Param::NONE,         0, 6, {0x81, 0x01, 0x04, 0x38, 0x03, 0xff}},
+        {CameraCommand::Type::FOCUS_AM,           Param::NONE,         0, 6, {0x81, 0x01, 0x04, 0x38, 0x10, 0xff}},
+        {CameraCommand::Type::SET_PRESET,         Param::PRESET,       0, 7, {0x81, 0x01, 0x04, 0x3f, 0x01, 0x00, 0xff}},
+        {CameraCommand::Type::CALL_PRESET,        Param::PRESET,       0, 7, {0x81, 0x01, 0x04, 0x3f, 0x02, 0x00, 0xff}},
+        {CameraCommand::Type::POWER_ON,           Param::NONE,         0, 6, {0x81, 0x01, 0x04, 0x00, 0x02, 0xff}},
+        {CameraCommand::Type::POWER_OFF,          Param::NONE,         0, 6, {0x81, 0x01, 0x04, 0x00, 0x03, 0xff}},
+        {CameraCommand::Type::MENU,               Param::NONE,         0, 6, {0x81, 0x01, 0x06, 0x06, 0x10, 0xff}},
+        {CameraCommand::Type::MENU_UP,            Param::NONE,         7, 9, {0x81, 0x01, 0x7e, 0x04, 0x40, 0x03, 0x01, 0x01, 0xff}},
+        {CameraCommand::Type::MENU_DOWN,          Param::NONE,         7, 9, {0x81, 0x01, 0x7e, 0x04, 0x40, 0x03, 0x02, 0x01, 0xff}},
+        {CameraCommand::Type::MENU_LEFT,          Param::NONE,         7, 9, {0x81, 0x01, 0x7e, 0x04, 0x40, 0x01, 0x03, 0x01, 0xff}},
+        {CameraCommand::Type::MENU_RIGHT,         Param::NONE,         7, 9, {0x81, 0x01, 0x7e, 0x04, 0x40, 0x02, 0x03, 0x01, 0xff}},
+        {CameraCommand::Type::MENU_ENTER,         Param::NONE,         7, 9, {0x81, 0x01, 0x7e, 0x04, 0x40, 0x07, 0x00, 0x01, 0xff}},
+        {CameraCommand::Type::MENU_BACK,          Param::NONE,         7, 9, {0x81, 0x01, 0x7e, 0x04, 0x40, 0x07, 0x01, 0x01, 0xff}},
+        {CameraCommand::Type::AUTO_FRAMING_START, Param::NONE,         0, 7, {0x81, 0x01, 0x7e, 0x04, 0x3a, 0x01, 0xff}},
+        {CameraCommand::Type::AUTO_FRAMING_STOP,  Param::NONE,         0, 7, {0x81, 0x01, 0x7e, 0x04, 0x3a, 0x00, 0xff}},
+        {CameraCommand::Type::ABSOLUTE_PAN_TILT,  Param::ABS_PAN_TILT, 0, 15, {0x81, 0x01, 0x06, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                                                                0x00, 0x00, 0x00, 0x00, 0xff}},
+        {CameraCommand::Type::ZOOM_DIRECT,        Param::ZOOM_POSITION, 0, 9, {0x81, 0x01, 0x04, 0x47, 0x00, 0x00, 0x00, 0x00, 0xff}},
+        {CameraCommand::Type::PAN_TILT_POS_INQ,   Param::NONE,         0, 5, {0x81, 0x09, 0x06, 0x12, 0xff}},
+        {CameraCommand::Type::ZOOM_POS_INQ,       Param::NONE,         0, 5, {0x81, 0x09, 0x04, 0x47, 0xff}},
+        {CameraCommand::Type::FOCUS_MODE_INQ,     Param::NONE,         0, 5, {0x81, 0x09, 0x04, 0x38, 0xff}},
+        {CameraCommand::Type::POWER_INQ,          Param::NONE,         0, 5, {0x81, 0x09, 0x04, 0x00, 0xff}},
+    };
+
+    // Generic VISCA cameras have no menu key commands: the menu is opened with preset 95
+    // and navigated by moving the camera.
+    static constexpr Template LOOSE_TABLE[NUM_TYPES] = {
+        STRICT_TABLE[0], STRICT_TABLE[1], STRICT_TABLE[2], STRICT_TABLE[3], STRICT_TABLE[4],
+        STRICT_TABLE[5], STRICT_TABLE[6], STRICT_TABLE[7], STRICT_TABLE[8], STRICT_TABLE[9],
+        STRICT_TABLE[10], STRICT_TABLE[11], STRICT_TABLE[12], STRICT_TABLE[13], STRICT_TABLE[14],
+        {CameraCommand::Type::MENU,               Param::NONE,         0, 7, {0x81, 0x01, 0x04, 0x3f, 0x02, 0x5f, 0xff}},
+        {CameraCommand::Type::MENU_UP,            Param::MENU_MOVE,    0, 9, {0x81, 0x01, 0x06, 0x01, 0x01, 0x0e, 0x03, 0x01, 0xff}},
+        {CameraCommand::Type::MENU_DOWN,          Param::MENU_MOVE,    0, 9, {0x81, 0x01, 0x06, 0x01, 0x01, 0x0e, 0x03, 0x02, 0xff}},
+        {CameraCommand::Type::MENU_LEFT,          Param::MENU_MOVE,    0, 9, {0x81, 0x01, 0x06, 0x01, 0x0e, 0x01, 0x01, 0x03, 0xff}},
+        {CameraCommand::Type::MENU_RIGHT,         Param::MENU_MOVE,    0, 9, {0x81, 0x01, 0x06, 0x01, 0x0e, 0x01, 0x02, 0x03, 0xff}},
+        {CameraCommand::Type::MENU_ENTER,         Param::NONE,         0, 6, {0x81, 0x01, 0x06, 0x06, 0x05, 0xff}},
+        {CameraCommand::Type::MENU_BACK,          Param::NONE,         0, 6, {0x81, 0x01, 0x06, 0x06, 0x04, 0xff}},
+        STRICT_TABLE[22], STRICT_TABLE[23], STRICT_TABLE[24], STRICT_TABLE[25], STRICT_TABLE[26],
+        STRICT_TABLE[27], STRICT_TABLE[28], STRICT_TABLE[29],
+    };
+
+    static constexpr bool isOrdered(const Template* table, size_t i = 0) {
+        return i == NUM_TYPES || (static_cast<size_t>(table[i].type) == i && isOrdered(table, i+1));
+    }
+
+    // Encodes the VISCA packet of cmd into buf, which must hold MAX_PACKET_SIZE bytes.
+    // Returns the packet length, or 0 if the command parameter is invalid.
+    static size_t encode(const Template* table, const Limits& limits, const CameraCommand& cmd, uint8_t* buf) {
+        const Template& t = table[static_cast<size_t>(cmd.type)];
+        for (size_t i = 0; i < t.len; i++) buf[i] = t.bytes[i];
+
+        switch (t.param) {
+            case Param::NONE:
+                break;
+
+            case Param::PAN_TILT:
+                buf[4] = clamp(cmd.arg1 < 0? -cmd.arg1 : cmd.arg1, limits.MIN_PAN_SPEED, limits.MAX_PAN_SPEED);
+                buf[5] = clamp(cmd.arg2 < 0? -cmd.arg2 : cmd.arg2, limits.MIN_TILT_SPEED, limits.MAX_TILT_SPEED);
+                buf[6] = cmd.arg1 > 0? 0x02 : cmd.arg1 < 0? 0x01 : 0x03;
+                buf[7] = cmd.arg2 > 0? 0x02 : cmd.arg2 < 0? 0x01 : 0x03;
+                break;
+
+            case Param::SPEED_NIBBLE:
+                if (cmd.type == CameraCommand::Type::ZOOM_IN || cmd.type == CameraCommand::Type::ZOOM_OUT)
+                    buf[4] |= clamp(cmd.arg1, limits.MIN_ZOOM_SPEED, limits.MAX_ZOOM_SPEED) & 0x0f;
+                else
+                    buf[4] |= clamp(cmd.arg1, limits.MIN_FOCUS_SPEED, limits.MAX_FOCUS_SPEED) & 0x0f;
+                break;
+
+            case Param::PRESET:
+                if (cmd.arg1 < 0 || unsigned(cmd.arg1) < limits.MIN_PRESET_NO || unsigned(cmd.arg1) > limits.MAX_PRESET_NO)
+                    return 0;
+                buf[5] = static_cast<uint8_t>(cmd.arg1);
+                break;
+
+            case Param::ABS_PAN_TILT:
+                buf[4] = clamp(cmd.arg3, limits.MIN_PAN_SPEED, limits.MAX_PAN_SPEED);
+                buf[5] = clamp(cmd.arg3, limits.MIN_TILT_SPEED, limits.MAX_TILT_SPEED);
+                toNibbles(static_cast<uint16_t>(cmd.arg1), buf + 6);
+                toNibbles(static_cast<uint16_t>(cmd.arg2), buf + 10);
+                break;
+
+            case Param::ZOOM_POSITION:
+                toNibbles(static_cast<uint16_t>(cmd.arg1), buf + 4);
+                break;
+
+            case Param::MENU_MOVE:
+                if (buf[6] != 0x03) buf[4] = clamp(buf[4], limits.MIN_PAN_SPEED, limits.MAX_PAN_SPEED);
+                if (buf[7] != 0x03) buf[5] = clamp(buf[5], limits.MIN_TILT_SPEED, limits.MAX_TILT_SPEED);
+                break;
+        }
+        return t.len;
+    }
+
+    // VISCA over IP payload type of an encoded packet: inquiries have category 0x09
+    static uint16_t payloadTypeOf(const uint8_t* payload) { return payload[1] == 0x09? 0x0110 : 0x0100; }
+
+    static void encodeHeader(uint8_t* buf, uint16_t payloadType, size_t payloadLen, uint32_t seqNo) {
+        buf[0] = payloadType >> 8;
+        buf[1] = payloadType & 0xff;
+        buf[2] = (payloadLen >> 8) & 0xff;
+        buf[3] = payloadLen & 0xff;
+        buf[4] = (seqNo >> 24) & 0xff;
+        buf[5] = (seqNo >> 16) & 0xff;
+        buf[6] = (seqNo >>  8) & 0xff;
+        buf[7] = seqNo & 0xff;
+    }
+
+    private:
+        static uint8_t clamp(int v, unsigned lo, unsigned hi) {
+            return static_cast<uint8_t>(v < int(lo)? lo : v > int(hi)? hi : unsigned(v));
+        }
+        static void toNibbles(uint16_t v, uint8_t* p) {
+            p[0] = (v >> 12) & 0x0f;
+            p[1] = (v >> 8) & 0x0f;
+            p[2] = (v >> 4) & 0x0f;
+            p[3] = v & 0x0f;
+        }
+};
+
+static_assert(ViscaEncoder::isOrdered(ViscaEncoder::STRICT_TABLE), "STRICT_TABLE must follow CameraCommand::Type order");
+static_assert(ViscaEncoder::isOrdered(ViscaEncoder::LOOSE_TABLE), "LOOSE_TABLE must follow CameraCommand::Type order");
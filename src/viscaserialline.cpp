@@ -0,0 +1,172 @@
+// vim:ts=4:sw=4:et:cin
+
+#include "viscaserialline.h"
+#include <cstring>
+#include <QTimer>
+#include <QDebug>
+#include "visca.h"
+
+ViscaSerialLine::ViscaSerialLine(const QString& portName, qint32 baud, bool visca, QObject* parent)
+    : QObject(parent), name(portName), baudRate(baud), isVisca(visca)
+{
+    port = new QSerialPort(this);
+    port->setPortName(name);
+    port->setBaudRate(baudRate);
+    port->setDataBits(QSerialPort::Data8);
+    port->setParity(QSerialPort::NoParity);
+    port->setStopBits(QSerialPort::OneStop);
+    port->setFlowControl(QSerialPort::NoFlowControl);
+    connect(port, &QSerialPort::readyRead, this, &ViscaSerialLine::onReadyRead);
+    connect(port, &QSerialPort::errorOccurred, this, &ViscaSerialLine::onError);
+
+    pacer = new QTimer(this);
+    pacer->setSingleShot(true);
+    pacer->setTimerType(Qt::PreciseTimer);
+    connect(pacer, &QTimer::timeout, this, &ViscaSerialLine::sendNext);
+    clock.start();
+
+    //Queued, so the port is opened in the thread the line runs in
+    QMetaObject::invokeMethod(this, "open", Qt::QueuedConnection);
+}
+
+void ViscaSerialLine::addCamera(CameraConnect* camera, uint8_t address)
+{
+    if (address < 1 || address > MAX_ADDRESS) return;
+    if (cameras[address]) {
+        qWarning("Two cameras at address %u of %s, replies only reach the first one.", unsigned(address),
+                name.toUtf8().constData());
+        return;
+    }
+    cameras[address] = camera;
+}
+
+void ViscaSerialLine::open()
+{
+    if (!port->open(QIODevice::ReadWrite)) {
+        qWarning("Cannot open VISCA line %s: %s", name.toUtf8().constData(), port->errorString().toUtf8().constData());
+        QTimer::singleShot(REOPEN_MS, this, &ViscaSerialLine::open);
+        return;
+    }
+    isLineOpen = true;
+    rxLen = 0;
+    isRxOverflow = false;
+    for (FrameQueue& q : txQueue) q.head = q.tail = 0;
+    lineFreeAtUs = 0;
+
+    if (isVisca) {
+        //Number the chain from 1 and clear the command buffers of every camera
+        static const uint8_t ADDRESS_SET[] = {0x88, 0x30, 0x01, 0xff};
+        static const uint8_t IF_CLEAR[] = {0x88, 0x01, 0x00, 0x01, 0xff};
+        send(ADDRESS_SET, sizeof(ADDRESS_SET), true);
+        send(IF_CLEAR, sizeof(IF_CLEAR), true);
+    }
+    emit opened();
+}
+
+void ViscaSerialLine::onError(QSerialPort::SerialPortError error)
+{
+    if (error != QSerialPort::ResourceError || !isLineOpen) return;
+    //Unplugged adapter, the cameras wait for the line to come back
+    qWarning("VISCA line %s lost: %s", name.toUtf8().constData(), port->errorString().toUtf8().constData());
+    isLineOpen = false;
+    pacer->stop();
+    port->close();
+    emit closed();
+    QTimer::singleShot(REOPEN_MS, this, &ViscaSerialLine::open);
+}
+
+bool ViscaSerialLine::send(const uint8_t* frame, size_t len, bool isUrgent)
+{
+    if (!isLineOpen || len > MAX_FRAME_SIZE) return false;
+    FrameQueue& q = txQueue[isUrgent? 0 : 1];
+    if (q.tail - q.head == TX_QUEUE_SIZE) return false;
+    Frame& f = q.buf[q.tail++ & (TX_QUEUE_SIZE - 1)];
+    f.len = static_cast<uint8_t>(len);
+    std::memcpy(f.data, frame, len);
+    if (!pacer->isActive()) sendNext();
+    return true;
+}
+
+void ViscaSerialLine::sendNext()
+{
+    if (!isLineOpen) return;
+    qint64 nowUs = clock.nsecsElapsed() / 1000;
+    if (nowUs < lineFreeAtUs) {
+        pacer->start(static_cast<int>((lineFreeAtUs - nowUs + 999) / 1000));
+        return;
+    }
+
+    FrameQueue* q = nullptr;
+    for (FrameQueue& candidate : txQueue) {
+        if (candidate.head != candidate.tail) {
+            q = &candidate;
+            break;
+        }
+    }
+    if (!q) return;
+    const Frame& f = q->buf[q->head++ & (TX_QUEUE_SIZE - 1)];
+    if (port->write(reinterpret_cast<const char*>(f.data), f.len) != f.len) {
+        qWarning("VISCA line %s write error: %s", name.toUtf8().constData(), port->errorString().toUtf8().constData());
+    }
+    //8N1, 10 bits per byte
+    lineFreeAtUs = nowUs + f.len * 10 * 1000000LL / baudRate;
+
+    for (const FrameQueue& rest : txQueue) {
+        if (rest.head != rest.tail) {
+            pacer->start(static_cast<int>((lineFreeAtUs - nowUs + 999) / 1000));
+            return;
+        }
+    }
+}
+
+//Replies start with 0x80 + (address << 4) for cameras 1 to 7, or 0x88 for a broadcast coming back
+static bool isFrameStart(uint8_t b)
+{
+    return b == 0x88 || ((b & 0x0f) == 0 && b >= 0x90);
+}
+
+void ViscaSerialLine::onReadyRead()
+{
+    if (!isVisca) {
+        port->readAll(); //Pelco status replies are not used
+        return;
+    }
+    char buf[64];
+    qint64 n;
+    while ((n = port->read(buf, sizeof(buf))) > 0) {
+        for (qint64 i = 0; i < n; i++) {
+            uint8_t b = static_cast<uint8_t>(buf[i]);
+            if (rxLen == 0 && !isRxOverflow && !isFrameStart(b)) continue; //resynchronise on a reply header
+            if (rxLen < MAX_FRAME_SIZE) {
+                rxBuf[rxLen++] = b;
+            } else {
+                isRxOverflow = true;
+            }
+            if (b != 0xff) continue;
+            if (!isRxOverflow) dispatch(rxBuf, rxLen);
+            rxLen = 0;
+            isRxOverflow = false;
+        }
+    }
+}
+
+void ViscaSerialLine::dispatch(const uint8_t* frame, size_t len)
+{
+    if (frame[0] == 0x88) {
+        //Broadcasts pass the whole chain: 88 30 0n FF after the address set, n being the first unused
+        //address, and 88 01 00 01 FF after IF_Clear. Neither is a camera reply.
+        if (len == 4 && frame[1] == 0x30) {
+            unsigned numCameras = (frame[2] & 0x0f) - 1u;
+            for (unsigned address = MAX_ADDRESS; address > numCameras; address--) {
+                if (!cameras[address]) continue;
+                qWarning("Only %u cameras answered on %s, camera at address %u is missing.", numCameras,
+                        name.toUtf8().constData(), address);
+                break;
+            }
+        }
+        return;
+    }
+    uint8_t address = (frame[0] >> 4) & 0x07;
+    if (!cameras[address]) return;
+    cameras[address]->processDatagram(reinterpret_cast<const char*>(frame), len);
+}
@@ -0,0 +1,85 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+#include <QSerialPort>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+class CameraConnect;
+
+// One RS-232/RS-422 VISCA line with up to 7 daisy-chained cameras. Frames are
+// written no faster than the baud rate drains them, so nothing piles up in the
+// driver buffer and a stop never waits behind frames already handed to the port;
+// stops are also sent ahead of any other waiting frame. Replies are handed to
+// the camera whose address they carry. A line of Pelco cameras uses the same
+// pacing; its cameras do not reply.
+class ViscaSerialLine : public QObject {
+    Q_OBJECT
+    public:
+        ViscaSerialLine(const QString& portName, qint32 baudRate, bool isVisca, QObject* parent = nullptr);
+
+        static constexpr uint8_t MAX_ADDRESS = 7;
+        static constexpr uint8_t BROADCAST = 8;
+        static constexpr size_t MAX_FRAME_SIZE = 16;
+        static constexpr size_t TX_QUEUE_SIZE = 64;     //per priority
+        static constexpr int REOPEN_MS = 1000;
+
+        const QString& portName() const { return name; }
+        bool isOpen() const { return isLineOpen; }
+        bool isViscaLine() const { return isVisca; }
+
+        // address is the position in the chain, 1 to MAX_ADDRESS
+        void addCamera(CameraConnect* camera, uint8_t address);
+
+        // Queues a frame, urgent frames go out first. Returns false if the line is closed or the queue is full.
+        bool send(const uint8_t* frame, size_t len, bool isUrgent);
+
+    signals:
+        void opened();  //the chain has been numbered, cameras start over
+        void closed();
+
+    private slots:
+        void open();
+        void onReadyRead();
+        void onError(QSerialPort::SerialPortError error);
+        void sendNext();
+
+    private:
+        struct Frame {
+            uint8_t len;
+            uint8_t data[MAX_FRAME_SIZE];
+        };
+        struct FrameQueue {
+            Frame  buf[TX_QUEUE_SIZE];
+            size_t head = 0;
+            size_t tail = 0;
+        };
+        static_assert((TX_QUEUE_SIZE & (TX_QUEUE_SIZE - 1)) == 0, "TX_QUEUE_SIZE must be a power of 2");
+        void dispatch(const uint8_t* frame, size_t len);
+
+        const QString name;
+        const qint32 baudRate;
+        const bool isVisca;
+        QSerialPort* port;
+        bool isLineOpen = false;
+        CameraConnect* cameras[MAX_ADDRESS + 1] = {};
+
+        //Transmit pacing, the line is busy until the last frame has been clocked out
+        FrameQueue txQueue[2];  //urgent, normal
+        QTimer* pacer;
+        QElapsedTimer clock;
+        qint64 lineFreeAtUs = 0;
+
+        //Replies are framed by their 0xff terminator
+        uint8_t rxBuf[MAX_FRAME_SIZE];
+        size_t rxLen = 0;
+        bool isRxOverflow = false;
+};
@@ -0,0 +1,303 @@
+// vim:ts=4:sw=4:et:cin
+
+#include "viscatransport.h"
+#include <cstring>
+#include <QDebug>
+#include "visca.h"
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+#include <QSocketNotifier>
+#else
+#include <QUdpSocket>
+#endif
+
+ViscaTransport::ViscaTransport(QObject* parent)
+    : QObject(parent)
+{
+#ifdef Q_OS_LINUX
+    //Dual stack, so IPv4 and IPv6 cameras share the socket, IPv4 only if IPv6 is disabled
+    fd = ::socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        int off = 0;
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        sockaddr_in6 any;
+        std::memset(&any, 0, sizeof(any));
+        any.sin6_family = AF_INET6;
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&any), sizeof(any)) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        family = AF_INET;
+        fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_in any;
+        std::memset(&any, 0, sizeof(any));
+        any.sin_family = AF_INET;
+        if (fd >= 0 && ::bind(fd, reinterpret_cast<sockaddr*>(&any), sizeof(any)) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        qWarning("UDP Bind Error: %s", std::strerror(errno));
+        return;
+    }
+    readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(readNotifier, &QSocketNotifier::activated, this, &ViscaTransport::processDatagrams);
+#else
+    socket = new QUdpSocket(this);
+    //Dual stack, so IPv4 and IPv6 cameras share the socket
+    if (!socket->bind(QHostAddress::Any, 0)) {
+        qWarning("UDP Bind Error: %s", socket->errorString().toUtf8().constData());
+    }
+    connect(socket, &QUdpSocket::readyRead, this, &ViscaTransport::processDatagrams);
+#endif
+}
+
+ViscaTransport::~ViscaTransport()
+{
+#ifdef Q_OS_LINUX
+    if (fd >= 0) ::close(fd);
+#endif
+}
+
+unsigned ViscaTransport::addCamera(CameraConnect* camera)
+{
+    Peer p;
+    p.camera = camera;
+    peers.push_back(p);
+    return peers.size() - 1;
+}
+
+uint64_t ViscaTransport::keyOfV6(const uint8_t* address, quint16 port)
+{
+    uint64_t hi, lo;
+    std::memcpy(&hi, address, 8);
+    std::memcpy(&lo, address + 8, 8);
+    uint64_t mix = (hi * 0x9e3779b97f4a7c15ull) ^ lo;
+    return (uint64_t(1) << 63) | ((mix << 16) & ~(uint64_t(1) << 63)) | port; //bit 63 set, never an IPv4 key
+}
+
+uint64_t ViscaTransport::keyOf(const QHostAddress& address, quint16 port)
+{
+    bool isV4 = false;
+    quint32 v4 = address.toIPv4Address(&isV4);
+    if (isV4) return keyOfV4(v4, port);
+    Q_IPV6ADDR v6 = address.toIPv6Address();
+    return keyOfV6(reinterpret_cast<const uint8_t*>(&v6), port);
+}
+
+void ViscaTransport::setPeer(unsigned peerId, const QHostAddress& address, quint16 port)
+{
+    clearPeer(peerId);
+    Peer& p = peers[peerId];
+    p.address = address;
+    p.port = port;
+    p.key = keyOf(address, port);
+    bool isV4 = false;
+    quint32 v4 = address.toIPv4Address(&isV4);
+    p.isV6 = !isV4;
+    if (p.isV6) {
+        Q_IPV6ADDR v6 = address.toIPv6Address();
+        std::memcpy(p.v6, &v6, 16);
+    }
+    if (!peerByKey.emplace(p.key, peerId).second) {
+        qWarning("Two cameras at %s port %u, replies only reach the first one.",
+                address.toString().toUtf8().constData(), unsigned(port));
+    }
+
+#ifdef Q_OS_LINUX
+    //The destination of sendmmsg() must match the family of the socket
+    std::memset(&p.sa, 0, sizeof(p.sa));
+    p.saLen = 0;
+    if (family == AF_INET6) {
+        sockaddr_in6* sa = reinterpret_cast<sockaddr_in6*>(&p.sa);
+        sa->sin6_family = AF_INET6;
+        sa->sin6_port = htons(port);
+        if (isV4) { //IPv4-mapped ::ffff:a.b.c.d
+            sa->sin6_addr.s6_addr[10] = 0xff;
+            sa->sin6_addr.s6_addr[11] = 0xff;
+            quint32 be = htonl(v4);
+            std::memcpy(&sa->sin6_addr.s6_addr[12], &be, 4);
+        } else {
+            std::memcpy(&sa->sin6_addr, p.v6, 16);
+            sa->sin6_scope_id = address.scopeId().toUInt();
+        }
+        p.saLen = sizeof(sockaddr_in6);
+    } else if (isV4) {
+        sockaddr_in* sa = reinterpret_cast<sockaddr_in*>(&p.sa);
+        sa->sin_family = AF_INET;
+        sa->sin_port = htons(port);
+        sa->sin_addr.s_addr = htonl(v4);
+        p.saLen = sizeof(sockaddr_in);
+    } else {
+        qWarning("IPv6 camera %s is not reachable, IPv6 is not available.", address.toString().toUtf8().constData());
+    }
+#endif
+}
+
+void ViscaTransport::clearPeer(unsigned peerId)
+{
+    Peer& p = peers[peerId];
+    if (p.port == 0) return;
+    auto it = peerByKey.find(p.key);
+    if (it != peerByKey.end() && it->second == peerId) peerByKey.erase(it);
+    p.port = 0;
+}
+
+bool ViscaTransport::send(unsigned peerId, const uint8_t* data, size_t len)
+{
+    const Peer& p = peers[peerId];
+    if (p.port == 0 || len > MAX_DATAGRAM_SIZE) return false;
+#ifdef Q_OS_LINUX
+    if (p.saLen == 0) return false;
+#endif
+    if (txCount == MAX_BATCH) flush();
+
+    TxPacket& pkt = txBatch[txCount++];
+    pkt.peer = peerId;
+    pkt.len = static_cast<uint32_t>(len);
+    std::memcpy(pkt.data, data, len);
+
+    //Everything queued until the event loop runs again leaves in one batch
+    if (!isFlushScheduled) {
+        isFlushScheduled = true;
+        QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void ViscaTransport::flush()
+{
+    isFlushScheduled = false;
+    if (txCount == 0) return;
+
+#ifdef Q_OS_LINUX
+    mmsghdr msgs[MAX_BATCH];
+    iovec iov[MAX_BATCH];
+    size_t n = txCount;
+    txCount = 0;
+    std::memset(msgs, 0, sizeof(msgs[0]) * n);
+    for (size_t i = 0; i < n; i++) {
+        Peer& p = peers[txBatch[i].peer];
+        iov[i].iov_base = txBatch[i].data;
+        iov[i].iov_len = txBatch[i].len;
+        msgs[i].msg_hdr.msg_name = &p.sa;
+        msgs[i].msg_hdr.msg_namelen = p.saLen;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t sent = 0;
+    while (sent < n) {
+        int r = ::sendmmsg(fd, msgs + sent, n - sent, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            //The first unsent datagram failed, report it and go on with the rest
+            qWarning("UDP Send Error: %s", std::strerror(errno));
+            //Full buffers only drop the datagram, the retransmit timer covers it; the peer is kept
+            bool isTransient = errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS;
+            if (!isTransient) peers[txBatch[sent].peer].camera->onSendError();
+            sent++;
+            continue;
+        }
+        sent += r;
+    }
+#else
+    flushFallback();
+#endif
+}
+
+void ViscaTransport::dispatch(uint64_t key, const uint8_t* v6, const char* data, size_t len)
+{
+    auto it = peerByKey.find(key);
+    if (it == peerByKey.end()) return; //not from a camera
+    const Peer& p = peers[it->second];
+    if (v6 && (!p.isV6 || std::memcmp(p.v6, v6, 16) != 0)) return;
+    p.camera->processDatagram(data, len);
+}
+
+#ifdef Q_OS_LINUX
+void ViscaTransport::processDatagrams()
+{
+    mmsghdr msgs[RX_BATCH];
+    iovec iov[RX_BATCH];
+    char buf[RX_BATCH][64]; //VISCA replies are at most 16 bytes plus the 8-byte header
+    sockaddr_storage from[RX_BATCH];
+
+    //Drain the socket, up to RX_BATCH datagrams per call
+    for (;;) {
+        std::memset(msgs, 0, sizeof(msgs));
+        for (size_t i = 0; i < RX_BATCH; i++) {
+            iov[i].iov_base = buf[i];
+            iov[i].iov_len = sizeof(buf[i]);
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = ::recvmmsg(fd, msgs, RX_BATCH, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) qWarning("UDP Read Error: %s", std::strerror(errno));
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const char* data = buf[i];
+            size_t len = msgs[i].msg_len;
+            if (from[i].ss_family == AF_INET) {
+                const sockaddr_in* sa = reinterpret_cast<const sockaddr_in*>(&from[i]);
+                dispatch(keyOfV4(ntohl(sa->sin_addr.s_addr), ntohs(sa->sin_port)), nullptr, data, len);
+            } else if (from[i].ss_family == AF_INET6) {
+                const sockaddr_in6* sa = reinterpret_cast<const sockaddr_in6*>(&from[i]);
+                const uint8_t* a = sa->sin6_addr.s6_addr;
+                static const uint8_t V4_MAPPED[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+                if (std::memcmp(a, V4_MAPPED, 12) == 0) {
+                    uint32_t v4 = (uint32_t(a[12]) << 24) | (a[13] << 16) | (a[14] << 8) | a[15];
+                    dispatch(keyOfV4(v4, ntohs(sa->sin6_port)), nullptr, data, len);
+                } else {
+                    dispatch(keyOfV6(a, ntohs(sa->sin6_port)), a, data, len);
+                }
+            }
+        }
+        if (size_t(n) < RX_BATCH) return;
+    }
+}
+#else
+void ViscaTransport::flushFallback()
+{
+    size_t n = txCount;
+    txCount = 0;
+    for (size_t i = 0; i < n; i++) {
+        const TxPacket& pkt = txBatch[i];
+        const Peer& p = peers[pkt.peer];
+        if (socket->writeDatagram(reinterpret_cast<const char*>(pkt.data), pkt.len, p.address, p.port) < 0) {
+            qWarning("UDP Send Error: %s", socket->errorString().toUtf8().constData());
+            if (socket->error() != QAbstractSocket::TemporaryError) p.camera->onSendError();
+        }
+    }
+}
+
+void ViscaTransport::processDatagrams()
+{
+    while (socket->hasPendingDatagrams()) {
+        char reply[64]; //VISCA replies are at most 16 bytes plus the 8-byte header
+        QHostAddress sender;
+        quint16 senderPort = 0;
+        qint64 n = socket->readDatagram(reply, sizeof(reply), &sender, &senderPort);
+        if (n < 0) {
+            qWarning("UDP Read Error: %s", socket->errorString().toUtf8().constData());
+            return;
+        }
+        bool isV4 = false;
+        sender.toIPv4Address(&isV4);
+        Q_IPV6ADDR v6 = sender.toIPv6Address();
+        dispatch(keyOf(sender, senderPort), isV4? nullptr : reinterpret_cast<const uint8_t*>(&v6), reply, n);
+    }
+}
+#endif
@@ -0,0 +1,89 @@
+// vim:ts=4:sw=4:et:cin
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+#include <QObject>
+#include <QHostAddress>
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+class QUdpSocket;
+class QSocketNotifier;
+QT_END_NAMESPACE
+
+class CameraConnect;
+
+// One UDP socket shared by all VISCA over IP cameras. Datagrams sent during an
+// event loop pass are collected and leave together when control returns to the
+// event loop, with a single sendmmsg() on Linux. Replies are handed to the
+// camera they came from, found by source address and port in a hash table.
+class ViscaTransport : public QObject {
+    Q_OBJECT
+    public:
+        explicit ViscaTransport(QObject* parent = nullptr);
+        virtual ~ViscaTransport();
+
+        static constexpr size_t MAX_DATAGRAM_SIZE = 32;
+        static constexpr size_t MAX_BATCH = 64;
+        static constexpr size_t RX_BATCH = 16;
+
+        // Returns the peer id the camera uses in the calls below
+        unsigned addCamera(CameraConnect* camera);
+        void setPeer(unsigned peerId, const QHostAddress& address, quint16 port);
+        void clearPeer(unsigned peerId);
+
+        // Queues a datagram to the camera's peer. Returns false if it cannot be queued;
+        // a failure at flush time is reported by CameraConnect::onSendError().
+        bool send(unsigned peerId, const uint8_t* data, size_t len);
+
+    private slots:
+        void flush();
+        void processDatagrams();
+
+    private:
+        struct Peer {
+            CameraConnect* camera;
+            QHostAddress   address;
+            quint16        port = 0;
+            uint64_t       key = 0;
+            bool           isV6 = false;
+            uint8_t        v6[16];      //to tell apart IPv6 peers sharing a key
+#ifdef Q_OS_LINUX
+            sockaddr_storage sa;
+            socklen_t        saLen = 0;
+#endif
+        };
+        struct TxPacket {
+            uint32_t peer;  //index in peers
+            uint32_t len;
+            uint8_t  data[MAX_DATAGRAM_SIZE];
+        };
+
+        // Demultiplexing key of an address and port, IPv4-mapped IPv6 addresses give the IPv4 key
+        static uint64_t keyOf(const QHostAddress& address, quint16 port);
+        static uint64_t keyOfV4(uint32_t address, quint16 port) { return (uint64_t(1) << 48) | (uint64_t(address) << 16) | port; }
+        static uint64_t keyOfV6(const uint8_t* address, quint16 port);
+        void dispatch(uint64_t key, const uint8_t* v6, const char* data, size_t len);
+
+        std::vector<Peer> peers;
+        std::unordered_map<uint64_t, unsigned> peerByKey;
+        TxPacket txBatch[MAX_BATCH];
+        size_t txCount = 0;
+        bool isFlushScheduled = false;
+
+#ifdef Q_OS_LINUX
+        // Native socket, so replies are drained with recvmmsg() without Qt's per-datagram calls
+        int fd = -1;
+        int family = AF_INET6;
+        QSocketNotifier* readNotifier = nullptr;
+#else
+        QUdpSocket* socket;
+        void flushFallback(); //one datagram at a time
+#endif
+};